@@ -34,19 +34,30 @@
 #include <ctype.h>
 #include <errno.h>
 #include <math.h>
+#include <float.h>
+#include <limits.h>
+#include <sys/stat.h>
+#if defined(__x86_64__) && defined(__linux__)
+#include <sys/mman.h>
+#endif
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
 #include "linenoise.h"
 #include "sds.h"
 
 /* UI */
 #define HINT_COLOR 33
 #define NUMBER_FMT "%.15g"
-#define OUTPUT_FMT "\x1b[33m= " NUMBER_FMT "\x1b[0m\n"
+#define OUTPUT_FMT "\x1b[33m= %s\x1b[0m\n"
 #define WORDEF_FMT "%s \x1b[33m\"%s\"\x1b[0m\n"
 
 /* Config */
 #define BUFFER_MAX 1024
 #define WORDS_FILE "clac/words"
 #define CAPACITY   0xFF
+#define RADIX_MIN  64
 
 /* Stack */
 #define count(S)   ((S)->top)
@@ -54,6 +65,55 @@
 #define isfull(S)  ((S)->top == CAPACITY)
 #define isempty(S) ((S)->top == 0)
 
+/* Compiler */
+#define INLINE_MAX 8
+#define BLOCKS_MAX 64
+#define REGS_MAX   64
+#define VEC_LANES  4
+#define VEC_CHUNK  64
+#define VEC_SLOTS  16
+#define DEPTH_MAX  1000
+#define LOOPS_MAX  10000000
+#define MEMO_SETS  256
+#define MEMO_WAYS  4
+#define MEMO_VALUES 8
+#define NUMS_MIN   65536
+
+/* Decimals */
+#define LIMB_BASE   1000000000
+#define LIMB_DIGITS 9
+#define PRECISION   50
+#define GUARD       9
+#define KARATSUBA_MIN 32
+#define EXP_MAX     100000000
+#define FACT_MAX    100000
+
+/* Fixed point */
+#ifdef __SIZEOF_INT128__
+typedef __int128 fixed;
+typedef unsigned __int128 ufixed;
+#define SCALE_MAX   18
+#else
+typedef long long fixed;
+typedef unsigned long long ufixed;
+#define SCALE_MAX   9
+#endif
+#define SCALE       2
+#define FIXED_MAX   ((fixed) (~(ufixed) 0 >> 1))
+
+/* Native code for x86-64 */
+#if defined(__x86_64__) && defined(__linux__)
+#define JIT
+#define HOT_CALLS  100
+#define JIT_MAX    4096
+#define JIT_SLOTS  15
+#endif
+
+/* Watching the words file */
+#ifdef __linux__
+#define WATCH
+#endif
+
 /* Arithmetic */
 #define modulo(A, B) ((A) - (B) * floor((A) / (B)))
 
@@ -63,16 +123,242 @@ typedef struct stack {
 } stack;
 
 typedef struct node {
-	sds word;
-	sds meaning;
-	struct node *next;
+	size_t word;
+	size_t meaning;
+	int code;
+	int size;
+	int state;
+	int pure;
+	int loops;
+	int memo;
+	int in;
+	int out;
+	int height;
+#ifdef JIT
+	void (*native)(double *);
+	size_t length;
+	int calls;
+#endif
 } node;
 
+enum state {
+	PENDING,
+	COMPILING,
+	DONE
+};
+
+enum opcode {
+	OP_END, OP_PUSH, OP_CALL, OP_HOLE,
+	OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_MOD, OP_POW,
+	OP_OR, OP_AND, OP_XOR, OP_SHL, OP_SHR, OP_POPCOUNT,
+	OP_SUM, OP_ADDN, OP_PROD, OP_MULN,
+	OP_MEAN, OP_VAR, OP_STDDEV, OP_MIN, OP_MAX, OP_MEDIAN, OP_PERCENTILE,
+	OP_SORT, OP_RSORT, OP_TRANSPOSE, OP_MMUL, OP_DET, OP_INV, OP_SOLVE,
+	OP_POLY, OP_POLYS,
+	OP_ABS, OP_CEIL, OP_FLOOR, OP_ROUND,
+	OP_SIN, OP_COS, OP_TAN, OP_ASIN, OP_ACOS, OP_ATAN, OP_ATAN2,
+	OP_LN, OP_LOG, OP_ERF, OP_FACT, OP_CHOOSE, OP_LGAMMA,
+	OP_DUP, OP_ROLL, OP_SWAP, OP_DROP, OP_COUNT, OP_CLEAR,
+	OP_STASH, OP_FETCH, OP_STASH1, OP_FETCH1, OP_STASHALL, OP_FETCHALL,
+	OP_SQUARE, OP_NIP, OP_ADDK, OP_SUBK, OP_MULK, OP_DIVK, OP_POWK,
+	OP_LT, OP_GT, OP_LE, OP_GE, OP_EQ, OP_NE,
+	OP_JUMP, OP_JZ, OP_TIMES, OP_LOOP, OP_MAP, OP_GET, OP_SET,
+	OP_RANGE, OP_IOTA, OP_NUM,
+	OPCODES
+};
+
+/* Words that delimit blocks of code. */
+enum keyword {
+	KW_IF, KW_ELSE, KW_THEN, KW_TIMES, KW_BEGIN, KW_WHILE, KW_MAP, KW_END
+};
+
+/* A compiled instruction. The argument is the index of the word to
+ * call or the distance to jump, and the value is the number to push. */
+typedef struct inst {
+	int op;
+	int arg;
+	double value;
+} inst;
+
+typedef struct builtin {
+	const char *name;
+	int op;
+} builtin;
+
+/* Two consecutive instructions that can be replaced by a single one,
+ * or removed if the replacement is OP_END. */
+typedef struct rewrite {
+	int first;
+	int second;
+	int op;
+} rewrite;
+
+/* Stack effect of an instruction: how many items it needs and how
+ * many it leaves. Instructions that depend on anything other than
+ * their arguments are not pure. */
+typedef struct effect {
+	int in;
+	int out;
+	int pure;
+} effect;
+
+static builtin builtins[] = {
+	{"_", OP_HOLE},
+	{"+", OP_ADD},
+	{"-", OP_SUB},
+	{"*", OP_MUL},
+	{"/", OP_DIV},
+	{"%", OP_MOD},
+	{"^", OP_POW},
+	{"or", OP_OR},
+	{"and", OP_AND},
+	{"xor", OP_XOR},
+	{"<<", OP_SHL},
+	{">>", OP_SHR},
+	{"popcount", OP_POPCOUNT},
+	{"sum", OP_SUM},
+	{"add", OP_ADDN},
+	{"prod", OP_PROD},
+	{"mul", OP_MULN},
+	{"mean", OP_MEAN},
+	{"var", OP_VAR},
+	{"stddev", OP_STDDEV},
+	{"min", OP_MIN},
+	{"max", OP_MAX},
+	{"median", OP_MEDIAN},
+	{"percentile", OP_PERCENTILE},
+	{"sort", OP_SORT},
+	{"rsort", OP_RSORT},
+	{"transpose", OP_TRANSPOSE},
+	{"mmul", OP_MMUL},
+	{"det", OP_DET},
+	{"inv", OP_INV},
+	{"solve", OP_SOLVE},
+	{"poly", OP_POLY},
+	{"polys", OP_POLYS},
+	{"range", OP_RANGE},
+	{"iota", OP_IOTA},
+	{"abs", OP_ABS},
+	{"ceil", OP_CEIL},
+	{"floor", OP_FLOOR},
+	{"round", OP_ROUND},
+	{"sin", OP_SIN},
+	{"cos", OP_COS},
+	{"tan", OP_TAN},
+	{"asin", OP_ASIN},
+	{"acos", OP_ACOS},
+	{"atan", OP_ATAN},
+	{"atan2", OP_ATAN2},
+	{"ln", OP_LN},
+	{"log", OP_LOG},
+	{"erf", OP_ERF},
+	{"!", OP_FACT},
+	{"choose", OP_CHOOSE},
+	{"lgamma", OP_LGAMMA},
+	{"dup", OP_DUP},
+	{"roll", OP_ROLL},
+	{"swap", OP_SWAP},
+	{"drop", OP_DROP},
+	{"count", OP_COUNT},
+	{"clear", OP_CLEAR},
+	{"stash", OP_STASH},
+	{"fetch", OP_FETCH},
+	{".", OP_STASH1},
+	{",", OP_FETCH1},
+	{":", OP_STASHALL},
+	{";", OP_FETCHALL},
+	{"<", OP_LT},
+	{">", OP_GT},
+	{"<=", OP_LE},
+	{">=", OP_GE},
+	{"=", OP_EQ},
+	{"!=", OP_NE}
+};
+
+static const char *keywords[] = {
+	"if", "else", "then", "times", "begin", "while", "map", "end"
+};
+
+static effect effects[OPCODES] = {
+	[OP_PUSH]  = {0, 1, 1},
+	[OP_ADD]   = {2, 1, 1},
+	[OP_SUB]   = {2, 1, 1},
+	[OP_MUL]   = {2, 1, 1},
+	[OP_DIV]   = {2, 1, 1},
+	[OP_MOD]   = {2, 1, 1},
+	[OP_POW]   = {2, 1, 1},
+	[OP_OR]    = {2, 1, 1},
+	[OP_AND]   = {2, 1, 1},
+	[OP_XOR]   = {2, 1, 1},
+	[OP_SHL]   = {2, 1, 1},
+	[OP_SHR]   = {2, 1, 1},
+	[OP_POPCOUNT] = {1, 1, 1},
+	[OP_ABS]   = {1, 1, 1},
+	[OP_CEIL]  = {1, 1, 1},
+	[OP_FLOOR] = {1, 1, 1},
+	[OP_ROUND] = {1, 1, 1},
+	[OP_SIN]   = {1, 1, 1},
+	[OP_COS]   = {1, 1, 1},
+	[OP_TAN]   = {1, 1, 1},
+	[OP_ASIN]  = {1, 1, 1},
+	[OP_ACOS]  = {1, 1, 1},
+	[OP_ATAN]  = {1, 1, 1},
+	[OP_ATAN2] = {2, 1, 1},
+	[OP_LN]    = {1, 1, 1},
+	[OP_LOG]   = {1, 1, 1},
+	[OP_ERF]   = {1, 1, 1},
+	[OP_FACT]  = {1, 1, 1},
+	[OP_CHOOSE] = {2, 1, 1},
+	[OP_LGAMMA] = {1, 1, 1},
+	[OP_DUP]   = {1, 2, 1},
+	[OP_SWAP]  = {2, 2, 1},
+	[OP_DROP]  = {1, 0, 1},
+	[OP_SQUARE] = {1, 1, 1},
+	[OP_NIP]   = {2, 1, 1},
+	[OP_ADDK]  = {1, 1, 1},
+	[OP_SUBK]  = {1, 1, 1},
+	[OP_MULK]  = {1, 1, 1},
+	[OP_DIVK]  = {1, 1, 1},
+	[OP_POWK]  = {1, 1, 1},
+	[OP_LT]    = {2, 1, 1},
+	[OP_GT]    = {2, 1, 1},
+	[OP_LE]    = {2, 1, 1},
+	[OP_GE]    = {2, 1, 1},
+	[OP_EQ]    = {2, 1, 1},
+	[OP_NE]    = {2, 1, 1}
+};
+
+static rewrite rewrites[] = {
+	{OP_DUP, OP_MUL, OP_SQUARE},
+	{OP_SWAP, OP_DROP, OP_NIP},
+	{OP_PUSH, OP_ADD, OP_ADDK},
+	{OP_PUSH, OP_SUB, OP_SUBK},
+	{OP_PUSH, OP_MUL, OP_MULK},
+	{OP_PUSH, OP_DIV, OP_DIVK},
+	{OP_PUSH, OP_POW, OP_POWK},
+	{OP_SWAP, OP_SWAP, OP_END}
+};
+
 static stack stacks[] = {{{}, 0}, {{}, 0}};
 static stack *s0 = &stacks[0];
 static stack *s1 = &stacks[1];
-static node *head = NULL;
-static node *tail = NULL;
+static node *words = NULL;
+static int nwords = 0;
+static int maxwords = 0;
+static sds pool = NULL;
+static struct bucket *table = NULL;
+static int nbuckets = 0;
+static int maxbuckets = 0;
+static inst *code = NULL;
+static int ncode = 0;
+static int maxcode = 0;
+static long limit = 0;
+static int optimize = 1;
+
+/* Use libm for every lane of the vector code. */
+static int exact = 0;
+static sds path = NULL;
+static struct stat info;
 static sds result;
 static double hole = 0;
 
@@ -166,417 +452,6170 @@ static double mul(stack *s, int n) {
 	return a;
 }
 
-static node *get(sds word) {
-	node *curr = head;
+/* Statistics
+ *
+ * Chunks of numbers are folded into a summary: the mean and the sum
+ * of squared deviations of each chunk are computed in two tight loops
+ * and merged with the running summary, so the numbers can come from
+ * the stack or be streamed from a sequence. */
+typedef struct summary {
+	double n, mean, m2, min, max;
+} summary;
+
+static void gather(summary *z, stack *s) {
+	double sum = 0, m2 = 0, min, max, mean, delta, n;
+	int j, k = count(s);
+
+	if (k == 0) {
+		return;
+	}
+
+	min = max = s->items[0];
+
+	for (j = 0; j < k; j++) {
+		sum += s->items[j];
+		min = s->items[j] < min ? s->items[j] : min;
+		max = s->items[j] > max ? s->items[j] : max;
+	}
+
+	mean = sum / k;
+
+	for (j = 0; j < k; j++) {
+		m2 += (s->items[j] - mean) * (s->items[j] - mean);
+	}
+
+	if (z->n == 0) {
+		z->min = min;
+		z->max = max;
+	}
+
+	n = z->n + k;
+	delta = mean - z->mean;
+	z->mean += delta * k / n;
+	z->m2 += m2 + delta * delta * z->n * k / n;
+	z->min = min < z->min ? min : z->min;
+	z->max = max > z->max ? max : z->max;
+	z->n = n;
+}
+
+static double conclude(summary *z, int op) {
+	switch (op) {
+	case OP_MEAN: return z->n > 0 ? z->mean : NAN;
+	case OP_VAR: return z->n > 1 ? z->m2 / (z->n - 1) : NAN;
+	case OP_STDDEV: return z->n > 1 ? sqrt(z->m2 / (z->n - 1)) : NAN;
+	case OP_MIN: return z->n > 0 ? z->min : NAN;
+	case OP_MAX: return z->n > 0 ? z->max : NAN;
+	}
+
+	return NAN;
+}
+
+/* The k-th smallest of n numbers, moving the smaller ones before it
+ * and the larger ones after it. */
+static double nth(double *x, int n, int k) {
+	int lo = 0, hi = n - 1, i, j;
+	double p, t;
+
+	while (lo < hi) {
+		p = x[lo + (hi - lo) / 2];
+		i = lo;
+		j = hi;
+
+		while (i <= j) {
+			while (x[i] < p) {
+				i++;
+			}
+
+			while (x[j] > p) {
+				j--;
+			}
 
-	while (curr != NULL) {
-		if (!strcasecmp(word, curr->word)) {
-			return curr;
+			if (i <= j) {
+				t = x[i];
+				x[i++] = x[j];
+				x[j--] = t;
+			}
 		}
 
-		curr = curr->next;
+		if (k <= j) {
+			hi = j;
+		} else if (k >= i) {
+			lo = i;
+		} else {
+			break;
+		}
 	}
 
-	return NULL;
+	return x[k];
 }
 
-static void set(sds word, sds meaning) {
-	node *curr = get(word);
+/* Interpolate between the closest ranks, selecting them instead of
+ * sorting the stack. */
+static double percentile(stack *s, double p) {
+	int j, k, n = count(s);
+	double h = (n - 1) * p / 100;
+	double a, b;
 
-	if (curr != NULL) {
-		fprintf(stderr, "Duplicate definition of \"%s\"\n", word);
-		curr->meaning = meaning;
-		return;
+	clear(s);
+
+	if (n == 0 || !(p >= 0 && p <= 100)) {
+		return NAN;
 	}
 
-	curr = (node *) malloc(sizeof(node));
+	k = floor(h);
+	a = b = nth(s->items, n, k);
 
-	if (curr == NULL) {
-		fprintf(stderr, "Not enough memory to load words\n");
-		exit(1);
+	for (j = k + 1; j < n && h > k; j++) {
+		b = j == k + 1 || s->items[j] < b ? s->items[j] : b;
 	}
 
-	curr->word = word;
-	curr->meaning = meaning;
-	curr->next = NULL;
-	if (head == NULL) {
-		head = curr;
-	} else {
-		tail->next = curr;
+	return a + (h - k) * (b - a);
+}
+
+static double statistic(stack *s, int op) {
+	summary z = {0};
+
+	if (op == OP_MEDIAN) {
+		return percentile(s, 50);
 	}
-	tail = curr;
+
+	gather(&z, s);
+	clear(s);
+
+	return conclude(&z, op);
 }
 
-static void cleanup() {
-	node *curr;
+/* Sorting
+ *
+ * Numbers are sorted by their bit patterns, flipped so that they order
+ * like the numbers do: small stacks by insertion, and larger ones one
+ * byte at a time from the least significant, skipping the bytes that
+ * are the same in every number. */
+static unsigned long long key(double x) {
+	unsigned long long u;
+
+	memcpy(&u, &x, sizeof(u));
+	return u >> 63 ? ~u : u | 1ULL << 63;
+}
+
+static double unkey(unsigned long long u) {
+	double x;
 
-	while (head != NULL) {
-		curr = head;
-		head = curr->next;
+	u = u >> 63 ? u & ~(1ULL << 63) : ~u;
+	memcpy(&x, &u, sizeof(x));
+	return x;
+}
+
+static void sort(stack *s, int reverse) {
+	unsigned long long a[CAPACITY], b[CAPACITY], *x = a, *y = b, *t, k;
+	int c[256], n = count(s), i, j, d, m;
+
+	for (i = 0; i < n; i++) {
+		a[i] = reverse ? ~key(s->items[i]) : key(s->items[i]);
+	}
+
+	for (i = 1; i < n && n < RADIX_MIN; i++) {
+		for (k = a[i], j = i; j > 0 && a[j-1] > k; j--) {
+			a[j] = a[j-1];
+		}
+
+		a[j] = k;
+	}
+
+	for (d = 0; d < 64 && n >= RADIX_MIN; d += 8) {
+		memset(c, 0, sizeof(c));
+
+		for (i = 0; i < n; i++) {
+			c[x[i] >> d & 0xFF]++;
+		}
+
+		if (c[x[0] >> d & 0xFF] == n) {
+			continue;
+		}
+
+		for (i = 0, j = 0; i < 256; i++) {
+			m = c[i];
+			c[i] = j;
+			j += m;
+		}
+
+		for (i = 0; i < n; i++) {
+			y[c[x[i] >> d & 0xFF]++] = x[i];
+		}
 
-		sdsfree(curr->word);
-		sdsfree(curr->meaning);
+		t = x;
+		x = y;
+		y = t;
+	}
 
-		free(curr);
+	for (i = 0; i < n; i++) {
+		s->items[i] = unkey(reverse ? ~x[i] : x[i]);
 	}
 }
 
-static int parse(sds input) {
-	int argc;
-	sds *argv = sdssplitargs(input, &argc);
+/* Matrices
+ *
+ * A matrix is laid out on the stack row by row, from the bottom up,
+ * and the words that work on matrices pop their dimensions first. */
+static int span(stack *s, int op) {
+	int n = count(s), k;
+	double r, m, c;
 
-	if (argc == 0) {
-		sdsfreesplitres(argv, argc);
+	c = n > 0 ? s->items[n-1] : 0;
+	m = n > 1 ? s->items[n-2] : 0;
+	r = n > 2 ? s->items[n-3] : 0;
+
+	switch (op) {
+	case OP_TRANSPOSE:
+		r = m;
+		m = c;
+		c = 0;
+		k = 2;
+		break;
+	case OP_MMUL:
+		k = 3;
+		break;
+	case OP_SOLVE:
+		r = m = c;
+		c = 1;
+		k = 1;
+		break;
+	default:
+		r = m = c;
+		c = 0;
+		k = 1;
+	}
+
+	if (!(r >= 1 && m >= 1 && c >= 0 && r * m + m * c <= n - k) ||
+			r != floor(r) || m != floor(m) || c != floor(c)) {
 		return 0;
 	}
 
-	if (argc != 2) {
-		sdsfreesplitres(argv, argc);
-		fprintf(stderr, "Incorrect definition: %s\n", input);
-		return 1;
+	return k + r * m + m * c;
+}
+
+/* Factor a square matrix in place into a unit lower triangle and an
+ * upper triangle, choosing the largest pivot in each column. Along
+ * with each entry goes a bound on the magnitude of the terms that were
+ * added to get it, and a pivot that is within rounding error of that
+ * bound is taken as zero, so singular matrices give a zero determinant
+ * and infinite inverses. Returns the sign of the permutation. */
+static int decompose(double *a, int n, int *p) {
+	double e[CAPACITY], t, l;
+	int i, j, k, q, sign = 1;
+
+	for (i = 0; i < n; i++) {
+		p[i] = i;
 	}
 
-	set(argv[0], argv[1]);
+	for (i = 0; i < n * n; i++) {
+		e[i] = fabs(a[i]);
+	}
 
-	return 0;
+	for (k = 0; k < n; k++) {
+		for (q = k, i = k + 1; i < n; i++) {
+			if (fabs(a[i*n+k]) > fabs(a[q*n+k])) {
+				q = i;
+			}
+		}
+
+		if (q != k) {
+			for (j = 0; j < n; j++) {
+				t = a[k*n+j];
+				a[k*n+j] = a[q*n+j];
+				a[q*n+j] = t;
+				t = e[k*n+j];
+				e[k*n+j] = e[q*n+j];
+				e[q*n+j] = t;
+			}
+
+			i = p[k];
+			p[k] = p[q];
+			p[q] = i;
+			sign = -sign;
+		}
+
+		if (fabs(a[k*n+k]) <= n * DBL_EPSILON * e[k*n+k]) {
+			a[k*n+k] = 0;
+		}
+
+		for (i = k + 1; i < n && a[k*n+k] != 0; i++) {
+			a[i*n+k] /= a[k*n+k];
+			l = (e[i*n+k] + fabs(a[i*n+k]) * e[k*n+k]) / fabs(a[k*n+k]);
+
+			for (j = k + 1; j < n; j++) {
+				a[i*n+j] -= a[i*n+k] * a[k*n+j];
+				e[i*n+j] += fabs(a[i*n+k]) * e[k*n+j] +
+					l * fabs(a[k*n+j]);
+			}
+		}
+	}
+
+	return sign;
 }
 
-static void load(sds filename) {
-	FILE *fp;
+/* Solve a factored system for a permuted right hand side. */
+static void substitute(double *a, int n, int *p, double *b, double *x) {
+	int i, j;
 
-	if ((fp = fopen(filename, "r")) == NULL) {
-		if (errno == ENOENT) {
-			return;
+	for (i = 0; i < n; i++) {
+		for (x[i] = b[p[i]], j = 0; j < i; j++) {
+			x[i] -= a[i*n+j] * x[j];
+		}
+	}
+
+	for (i = n - 1; i >= 0; i--) {
+		for (j = i + 1; j < n; j++) {
+			x[i] -= a[i*n+j] * x[j];
 		}
 
-		fprintf(stderr, "Can't open file %s\n", filename);
-		sdsfree(filename);
-		exit(1);
+		x[i] /= a[i*n+i];
 	}
+}
 
-	char buf[BUFFER_MAX+1];
-	int linecount, i;
+/* Replace a matrix and its dimensions with the result, or return 0 if
+ * the dimensions don't match the stack. */
+static int matrix(stack *s, int op) {
+	double a[CAPACITY], r[CAPACITY], e[CAPACITY], *m;
+	int p[CAPACITY], k = span(s, op), i, j, l, n, rows, cols, inner;
 
-	sds *lines;
-	sds content = sdsempty();
+	if (k == 0) {
+		fprintf(stderr, "\r\nWrong dimensions!\n");
+		return 0;
+	}
 
-	while(fgets(buf, BUFFER_MAX+1, fp) != NULL) {
-		content = sdscat(content, buf);
+	if (op == OP_MMUL && count(s) - k + s->items[count(s)-1] *
+			s->items[count(s)-3] > CAPACITY) {
+		fprintf(stderr, "\r\nStack is full!\n");
+		return 0;
 	}
 
-	fclose(fp);
+	switch (op) {
+	case OP_TRANSPOSE:
+		cols = pop(s);
+		rows = pop(s);
+		m = s->items + (count(s) -= rows * cols);
 
-	lines = sdssplitlen(content, strlen(content), "\n", 1, &linecount);
+		for (i = 0; i < rows; i++) {
+			for (j = 0; j < cols; j++) {
+				r[j*rows+i] = m[i*cols+j];
+			}
+		}
 
-	for (i = 0; i < linecount; i++) {
-		lines[i] = sdstrim(lines[i], " \t\r\n");
+		n = rows * cols;
+		break;
+	case OP_MMUL:
+		cols = pop(s);
+		inner = pop(s);
+		rows = pop(s);
+		n = rows * cols;
+		m = s->items + (count(s) -= rows * inner + inner * cols);
+		memset(r, 0, n * sizeof(double));
 
-		if (lines[i][0] == '#') {
-		  continue;
+		for (i = 0; i < rows; i++) {
+			for (l = 0; l < inner; l++) {
+				for (j = 0; j < cols; j++) {
+					r[i*cols+j] += m[i*inner+l] * m[rows*inner+l*cols+j];
+				}
+			}
 		}
+		break;
+	default:
+		n = pop(s);
+		m = s->items + (count(s) -= k - 1);
+		memcpy(a, m, n * n * sizeof(double));
+		i = decompose(a, n, p);
 
-		if (parse(lines[i]) != 0) {
-			sdsfreesplitres(lines, linecount);
+		if (op == OP_DET) {
+			for (r[0] = i, j = 0; j < n; j++) {
+				r[0] *= a[j*n+j];
+			}
 
-			fprintf(stderr, "(%s:%d)\n", filename, i+1);
-			exit(1);
+			if (r[0] == 0) {
+				r[0] = 0;
+			}
+
+			n = 1;
+		} else if (op == OP_SOLVE) {
+			substitute(a, n, p, m + n * n, r);
+		} else {
+			for (j = 0; j < n; j++) {
+				for (i = 0; i < n; i++) {
+					e[i] = i == j;
+				}
+
+				substitute(a, n, p, e, e + n);
+
+				for (i = 0; i < n; i++) {
+					r[i*n+j] = e[n+i];
+				}
+			}
+
+			n = n * n;
 		}
 	}
 
-	sdsfreesplitres(lines, linecount);
-	sdsfree(content);
-}
+	for (i = 0; i < n; i++) {
+		push(s, r[i]);
+	}
 
-static void eval(const char *input);
+	return 1;
+}
 
-static void process(sds word) {
-	double a, b;
-	char *z;
-	node *n;
+/* Polynomials
+ *
+ * Coefficients go from the highest power down, right above the number
+ * or numbers to evaluate, and the count of coefficients is popped
+ * first. They are evaluated by Horner's method, one coefficient at a
+ * time for all the numbers, and fused if the machine has a fast fma. */
+#ifdef FP_FAST_FMA
+#define madd(A, B, C) fma(A, B, C)
+#else
+#define madd(A, B, C) ((A) * (B) + (C))
+#endif
 
-	if (!strcmp(word, "_")) {
-		push(s0, hole);
-	} else if (!strcmp(word, "+")) {
-		if (count(s0) > 1) {
-			a = pop(s0);
-			b = pop(s0);
-			push(s0, a + b);
-		}
-	} else if (!strcmp(word, "-")) {
-		if (count(s0) > 1) {
-			a = pop(s0);
-			b = pop(s0);
-			push(s0, b - a);
-		}
-	} else if (!strcmp(word, "*")) {
-		if (count(s0) > 1) {
-			a = pop(s0);
-			b = pop(s0);
-			push(s0, b * a);
-		}
-	} else if (!strcmp(word, "/")) {
-		if (count(s0) > 1) {
-			a = pop(s0);
-			b = pop(s0);
-			push(s0, b / a);
-		}
-	} else if (!strcmp(word, "%")) {
-		if (count(s0) > 1) {
-			a = pop(s0);
-			b = pop(s0);
-			push(s0, modulo(b, a));
-		}
-	} else if (!strcmp(word, "^")) {
-		if (count(s0) > 1) {
-			a = pop(s0);
-			b = pop(s0);
-			push(s0, pow(b, a));
-		}
-	} else if (!strcmp(word, "or")) {
-		if (count(s0) > 1) {
-			a = pop(s0);
-			b = pop(s0);
-			push(s0, (int)fabs(b)|(int)fabs(a));
-		}
-	} else if (!strcmp(word, "and")) {
-		if (count(s0) > 1) {
-			a = pop(s0);
-			b = pop(s0);
-			push(s0, (int)fabs(b)&(int)fabs(a));
-		}
-	} else if (!strcmp(word, "xor")) {
-		if (count(s0) > 1) {
-			a = pop(s0);
-			b = pop(s0);
-			push(s0, (int)fabs(b)^(int)fabs(a));
-		}
-	} else if (!strcasecmp(word, "sum")) {
-		push(s0, add(s0, count(s0)));
-	} else if (!strcasecmp(word, "add")) {
-		push(s0, add(s0, pop(s0)));
-	} else if (!strcasecmp(word, "prod")) {
-		push(s0, mul(s0, count(s0)));
-	} else if (!strcasecmp(word, "mul")) {
-		push(s0, mul(s0, pop(s0)));
-	} else if (!strcasecmp(word, "abs")) {
-		if (count(s0) > 0) {
-			push(s0, fabs(pop(s0)));
-		}
-	} else if (!strcasecmp(word, "ceil")) {
-		if (count(s0) > 0) {
-			push(s0, ceil(pop(s0)));
-		}
-	} else if (!strcasecmp(word, "floor")) {
-		if (count(s0) > 0) {
-			push(s0, floor(pop(s0)));
-		}
-	} else if (!strcasecmp(word, "round")) {
-		if (count(s0) > 0) {
-			push(s0, round(pop(s0)));
-		}
-	} else if (!strcasecmp(word, "sin")) {
-		if (count(s0) > 0) {
-			push(s0, sin(pop(s0)));
-		}
-	} else if (!strcasecmp(word, "cos")) {
-		if (count(s0) > 0) {
-			push(s0, cos(pop(s0)));
-		}
-	} else if (!strcasecmp(word, "tan")) {
-		if (count(s0) > 0) {
-			push(s0, tan(pop(s0)));
-		}
-	} else if (!strcasecmp(word, "asin")) {
-		if (count(s0) > 0) {
-			push(s0, asin(pop(s0)));
-		}
-	} else if (!strcasecmp(word, "acos")) {
-		if (count(s0) > 0) {
-			push(s0, acos(pop(s0)));
-		}
-	} else if (!strcasecmp(word, "atan")) {
-		if (count(s0) > 0) {
-			push(s0, atan(pop(s0)));
-		}
-	} else if (!strcasecmp(word, "atan2")) {
-		if (count(s0) > 1) {
-			a = pop(s0);
-			b = pop(s0);
-			push(s0, atan2(b, a));
-		}
-	} else if (!strcasecmp(word, "ln")) {
-		if (count(s0) > 0) {
-			push(s0, log(pop(s0)));
-		}
-	} else if (!strcasecmp(word, "log")) {
-		if (count(s0) > 0) {
-			push(s0, log10(pop(s0)));
-		}
-	} else if (!strcasecmp(word, "erf")) {
-		if (count(s0) > 0) {
-			push(s0, erf(pop(s0)));
-		}
-	} else if (!strcasecmp(word, "!")) {
-		if (count(s0) > 0) {
-			a = pop(s0);
-
-			if (a == 0) {
-				push(s0, 1);
-			} else {
-				push(s0, a * tgamma(a));
-			}
-		}
-	} else if (!strcasecmp(word, "dup")) {
-		if (!isempty(s0)) {
-			push(s0, peek(s0));
-		}
-	} else if (!strcasecmp(word, "roll")) {
-		a = pop(s0);
-		b = pop(s0);
-
-		roll(s0, s1, b, a);
-	} else if (!strcasecmp(word, "swap")) {
-		if (count(s0) > 1) {
-			a = pop(s0);
-			b = pop(s0);
-
-			push(s0, a);
-			push(s0, b);
-		}
-	} else if (!strcasecmp(word, "drop")) {
-		pop(s0);
-	} else if (!strcasecmp(word, "count")) {
-		push(s0, (double) count(s0));
-	} else if (!strcasecmp(word, "clear")) {
-		clear(s0);
-	} else if (!strcasecmp(word, "stash")) {
-		move(s0, s1, pop(s0));
-	} else if (!strcasecmp(word, "fetch")) {
-		move(s1, s0, pop(s0));
-	} else if (!strcasecmp(word, ".")) {
-		move(s0, s1, 1);
-	} else if (!strcasecmp(word, ",")) {
-		move(s1, s0, 1);
-	} else if (!strcasecmp(word, ":")) {
-		move(s0, s1, count(s0));
-	} else if (!strcasecmp(word, ";")) {
-		move(s1, s0, count(s1));
-	} else if ((n = get(word)) != NULL) {
-		eval(n->meaning);
-	} else {
-		a = strtod(word, &z);
+static int degree(stack *s, int each) {
+	double n = count(s) > 0 ? s->items[count(s)-1] : 0;
 
-		if (*z == '\0') {
-			push(s0, a);
-		} else if (!isalpha(word[0])) {
-			push(s0, NAN);
-		}
+	if (!(n >= 1 && n == floor(n) && count(s) - 1 - n >= !each)) {
+		fprintf(stderr, "\r\nWrong dimensions!\n");
+		return 0;
 	}
+
+	return n;
 }
 
-static void eval(const char *input) {
-	int i, argc;
+static void poly(stack *s, int each) {
+	double c[CAPACITY], y[CAPACITY], *x;
+	int j, k, m, n = degree(s, each);
 
-	sds *argv = sdssplitargs(input, &argc);
+	if (n == 0) {
+		return;
+	}
 
-	for (i = 0; i < argc; i++) {
-		process(argv[i]);
+	pop(s);
+	memcpy(c, s->items + (count(s) -= n), n * sizeof(double));
+	m = each ? count(s) : 1;
+	x = s->items + count(s) - m;
+
+	for (j = 0; j < m; j++) {
+		y[j] = c[0];
 	}
 
-	sdsfreesplitres(argv, argc);
+	for (k = 1; k < n; k++) {
+		for (j = 0; j < m; j++) {
+			y[j] = madd(y[j], x[j], c[k]);
+		}
+	}
+
+	memcpy(x, y, m * sizeof(double));
 }
 
-static void completion(const char *input, linenoiseCompletions *lc) {}
+/* Numbers
+ *
+ * Values are doubles unless another kind of number is selected with
+ * $CLAC_MODE. Then the numbers live in an arena, and the stacks, the
+ * registers and the code hold their indices. Operations that look at
+ * the numbers are compiled to OP_NUM and run through calc, and the
+ * ones that only move items around work the same in every mode. The
+ * first number in the arena is zero, so popping from an empty stack
+ * still gives zero. */
+enum mode {
+	MODE_DOUBLE, MODE_INT, MODE_DECIMAL, MODE_FIXED, MODE_RATIONAL, MODES
+};
 
-static char *hints(const char *input, int *color, int *bold) {
-	int i;
+/* Numbers that can't be exact in the current mode are doubles. */
+enum kind {
+	K_REAL, K_INT, K_BIG, K_FIXED, K_RATIONAL
+};
 
-	clear(s0);
-	clear(s1);
+typedef struct num {
+	int kind;
+	long long i;
+	double d;
+	int sign;
+	int size;
+	long exp;
+	unsigned *limbs;
+	fixed q;
+	fixed den;
+} num;
 
-	eval(input);
-	sdsclear(result);
+static const char *modes[] = {"double", "int", "decimal", "fixed", "rational"};
+static int mode = MODE_DOUBLE;
+static int precision = PRECISION;
+static int scale = SCALE;
+static fixed unit = 100;
+static num *nums = NULL;
+static int nnums = 0;
+static int maxnums = 0;
+static int watermark = NUMS_MIN;
 
-	result = sdscat(result, " ");
+/* Stacks that hold numbers while a map runs its body on another one. */
+typedef struct root {
+	stack *s;
+	struct root *next;
+} root;
 
-	for (i = 0; i < count(s0); i++) {
-		result = sdscatprintf(result, " " NUMBER_FMT, s0->items[i]);
-	}
+static root *roots = NULL;
 
-	if (!isempty(s1)) {
-		result = sdscat(result, " ⋮");
+#define unbox(X) (&nums[(int) (X)])
 
-		for (i = s1->top-1; i > -1; i--) {
-			result = sdscatprintf(result, " " NUMBER_FMT, s1->items[i]);
+static double box(num x) {
+	if (nnums == maxnums) {
+		maxnums = maxnums ? maxnums * 2 : 256;
+		nums = (num *) realloc(nums, maxnums * sizeof(num));
+
+		if (nums == NULL) {
+			fprintf(stderr, "Not enough memory for numbers\n");
+			exit(1);
 		}
 	}
 
-	*color = HINT_COLOR;
+	nums[nnums] = x;
 
-	return result;
+	return nnums++;
 }
 
-static sds buildpath(const char *fmt, const char *dir) {
-	return sdscatfmt(sdsempty(), fmt, dir, WORDS_FILE);
+/* Decimals
+ *
+ * In decimal mode a number is a sign, a coefficient and a power of
+ * ten. The coefficient is a magnitude in base 10^9, least significant
+ * limb first, kept without leading zero limbs or trailing zero digits.
+ * Results are rounded to $CLAC_PRECISION significant digits, half to
+ * even. Every number owns its limbs, and they are freed when the
+ * arena is compacted. */
+enum rounding {
+	HALF_EVEN, HALF_UP, FLOOR, CEIL, TRUNC
+};
+
+static const unsigned tens[] = {
+	1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000,
+	1000000000
+};
+
+static unsigned *limbs(int n) {
+	unsigned *l = (unsigned *) calloc(n > 0 ? n : 1, sizeof(unsigned));
+
+	if (l == NULL) {
+		fprintf(stderr, "Not enough memory for numbers\n");
+		exit(1);
+	}
+
+	return l;
 }
 
-static void config() {
-	sds filename = NULL;
+/* Divide a magnitude by a small number in place, returning the
+ * remainder. */
+static unsigned mdivs(unsigned *a, int n, unsigned d) {
+	unsigned long long r = 0;
+	int k;
 
-	if (getenv("CLAC_WORDS") != NULL) {
-		filename = sdsnew(getenv("CLAC_WORDS"));
-	} else if (getenv("XDG_CONFIG_HOME") != NULL) {
-		filename = buildpath("%s/%s", getenv("XDG_CONFIG_HOME"));
-	} else if (getenv("HOME") != NULL) {
-		filename = buildpath("%s/.config/%s", getenv("HOME"));
+	for (k = n - 1; k >= 0; k--) {
+		r = r * LIMB_BASE + a[k];
+		a[k] = r / d;
+		r %= d;
 	}
 
-	if (filename) {
-		load(filename);
-		sdsfree(filename);
+	return r;
+}
+
+/* Add a magnitude into another one, which must have room for the
+ * carry. */
+static void macc(unsigned *r, int nr, const unsigned *a, int na) {
+	unsigned carry = 0;
+	int k;
+
+	for (k = 0; k < nr && (k < na || carry); k++) {
+		carry += r[k] + (k < na ? a[k] : 0);
+		r[k] = carry % LIMB_BASE;
+		carry /= LIMB_BASE;
 	}
 }
 
-int main(int argc, char **argv) {
-	char *line;
+/* Subtract a magnitude from a larger or equal one in place. */
+static void mdec(unsigned *r, int nr, const unsigned *a, int na) {
+	long long borrow = 0;
+	int k;
 
-	result = sdsempty();
+	for (k = 0; k < nr && (k < na || borrow); k++) {
+		borrow = (long long) r[k] - (k < na ? a[k] : 0) - borrow;
+		r[k] = borrow < 0 ? borrow + LIMB_BASE : borrow;
+		borrow = borrow < 0;
+	}
+}
 
-	config();
+static int mcmp(const unsigned *a, int na, const unsigned *b, int nb) {
+	while (na > 0 && a[na-1] == 0) na--;
+	while (nb > 0 && b[nb-1] == 0) nb--;
 
-	if (argc == 2) {
-		eval(argv[1]);
+	if (na != nb) {
+		return na > nb ? 1 : -1;
+	}
 
-		while (count(s0) > 0) {
-			printf(NUMBER_FMT "\n", pop(s0));
+	while (na-- > 0) {
+		if (a[na] != b[na]) {
+			return a[na] > b[na] ? 1 : -1;
 		}
+	}
 
-		exit(0);
+	return 0;
+}
+
+/* Multiply two magnitudes into r, which has room for na + nb limbs.
+ * Long operands are split in halves and multiplied with three products
+ * instead of four, using Karatsuba's method. */
+static void mmul(unsigned *r, const unsigned *a, int na, const unsigned *b, int nb) {
+	unsigned long long t;
+	unsigned *sa, *sb, *z;
+	const unsigned *x;
+	int j, k, m;
+
+	if (na < nb) {
+		x = a; a = b; b = x;
+		k = na; na = nb; nb = k;
 	}
 
-	if (argc > 2) {
-		fprintf(stderr, "usage: clac [expression]\n");
-		exit(1);
+	memset(r, 0, (na + nb) * sizeof(unsigned));
+
+	if (nb < KARATSUBA_MIN) {
+		for (j = 0; j < nb; j++) {
+			t = 0;
+
+			for (k = 0; k < na; k++) {
+				t += (unsigned long long) a[k] * b[j] + r[j+k];
+				r[j+k] = t % LIMB_BASE;
+				t /= LIMB_BASE;
+			}
+
+			r[j+na] = t;
+		}
+
+		return;
 	}
 
-	linenoiseSetHintsCallback(hints);
-	linenoiseSetCompletionCallback(completion);
+	m = (na + 1) / 2;
+
+	if (nb <= m) {
+		z = limbs(na - m + nb);
+		mmul(r, a, m, b, nb);
+		mmul(z, a + m, na - m, b, nb);
+		macc(r + m, na + nb - m, z, na - m + nb);
+		free(z);
+		return;
+	}
+
+	sa = limbs(m + 1);
+	sb = limbs(m + 1);
+	z = limbs(2 * m + 2);
+
+	memcpy(sa, a, m * sizeof(unsigned));
+	memcpy(sb, b, m * sizeof(unsigned));
+	macc(sa, m + 1, a + m, na - m);
+	macc(sb, m + 1, b + m, nb - m);
+
+	mmul(r, a, m, b, m);
+	mmul(r + 2 * m, a + m, na - m, b + m, nb - m);
+	mmul(z, sa, m + 1, sb, m + 1);
+	mdec(z, 2 * m + 2, r, 2 * m);
+	mdec(z, 2 * m + 2, r + 2 * m, na + nb - 2 * m);
+	macc(r + m, na + nb - m, z, 2 * m + 2);
+
+	free(sa);
+	free(sb);
+	free(z);
+}
+
+/* Make a decimal from its parts, taking ownership of the limbs. */
+static num big(int sign, long exp, unsigned *l, int n) {
+	num x = {K_BIG, 0, 0};
+	int k;
+
+	while (n > 0 && l[n-1] == 0) {
+		n--;
+	}
+
+	for (k = 0; k < n && l[k] == 0; k++);
+
+	if (k > 0 && k < n) {
+		memmove(l, l + k, (n - k) * sizeof(unsigned));
+		n -= k;
+		exp += k * LIMB_DIGITS;
+	}
+
+	while (n > 0 && l[0] % 10 == 0) {
+		mdivs(l, n, 10);
+		exp++;
+
+		if (l[n-1] == 0) {
+			n--;
+		}
+	}
+
+	x.sign = n > 0 ? sign : 1;
+	x.exp = n > 0 ? exp : 0;
+	x.size = n;
+	x.limbs = l;
+
+	return x;
+}
+
+static num copy(num *x) {
+	num y = *x;
+
+	if (x->kind == K_BIG) {
+		y.limbs = limbs(x->size);
+		memcpy(y.limbs, x->limbs, x->size * sizeof(unsigned));
+	}
+
+	return y;
+}
+
+static void release(num *x) {
+	if (x->kind == K_BIG) {
+		free(x->limbs);
+	}
+}
+
+static int ndigits(num *x) {
+	unsigned t;
+	int d;
+
+	if (x->size == 0) {
+		return 0;
+	}
+
+	t = x->limbs[x->size-1];
+
+	for (d = (x->size - 1) * LIMB_DIGITS; t > 0; d++) {
+		t /= 10;
+	}
+
+	return d;
+}
+
+/* The power of ten above the leading digit. */
+static long top(num *x) {
+	return x->exp + ndigits(x);
+}
+
+/* Digit k of the coefficient, counting from the least significant. */
+static unsigned digit(num *x, long k) {
+	if (k < 0 || k / LIMB_DIGITS >= x->size) {
+		return 0;
+	}
+
+	return x->limbs[k / LIMB_DIGITS] / tens[k % LIMB_DIGITS] % 10;
+}
+
+/* Drop the d least significant digits of a decimal, rounding what is
+ * left as specified. */
+static num chop(num x, long d, int how) {
+	unsigned rd = digit(&x, d - 1);
+	int k, n = x.size, sticky = 0, up;
+	long q = d / LIMB_DIGITS;
+
+	for (k = 0; k < n && k < (d - 1) / LIMB_DIGITS; k++) {
+		sticky |= x.limbs[k] != 0;
+	}
+
+	if ((d - 1) / LIMB_DIGITS < n) {
+		sticky |= x.limbs[(d - 1) / LIMB_DIGITS] % tens[(d - 1) % LIMB_DIGITS] != 0;
+	}
+
+	x.limbs = (unsigned *) realloc(x.limbs, (n + 1) * sizeof(unsigned));
+
+	if (x.limbs == NULL) {
+		fprintf(stderr, "Not enough memory for numbers\n");
+		exit(1);
+	}
+
+	if (q >= n) {
+		n = 0;
+	} else {
+		memmove(x.limbs, x.limbs + q, (n - q) * sizeof(unsigned));
+		n -= q;
+		mdivs(x.limbs, n, tens[d % LIMB_DIGITS]);
+	}
+
+	switch (how) {
+	case HALF_EVEN:
+		up = rd > 5 || (rd == 5 && (sticky || (n > 0 && x.limbs[0] & 1)));
+		break;
+	case HALF_UP:
+		up = rd >= 5;
+		break;
+	case FLOOR:
+		up = (rd || sticky) && x.sign < 0;
+		break;
+	case CEIL:
+		up = (rd || sticky) && x.sign > 0;
+		break;
+	default:
+		up = 0;
+	}
+
+	if (up) {
+		x.limbs[n++] = 0;
+
+		for (k = 0; ++x.limbs[k] == LIMB_BASE; k++) {
+			x.limbs[k] = 0;
+		}
+	}
+
+	return big(x.sign, x.exp + d, x.limbs, n);
+}
+
+/* Round a decimal to a number of significant digits. */
+static num fitto(num x, int p) {
+	int d = ndigits(&x) - p;
+	return d > 0 ? chop(x, d, HALF_EVEN) : x;
+}
+
+static num fit(num x) {
+	return fitto(x, precision);
+}
+
+/* Parse a decimal literal, or return 0 if the string isn't one. */
+static int scan(const char *s, num *x) {
+	const char *p = s + (*s == '-' || *s == '+');
+	const char *q;
+	long exp = 0, e;
+	int k, n = 0, size;
+	unsigned *l;
+	char *z;
+
+	for (q = p; isdigit(*q) || (*q == '.' && !strchr(q + 1, '.')); q++) {
+		if (*q == '.') {
+			exp = -(long) strspn(q + 1, "0123456789");
+		} else {
+			n++;
+		}
+	}
+
+	if (n == 0) {
+		return 0;
+	}
+
+	if (*q == 'e' || *q == 'E') {
+		errno = 0;
+		e = strtol(q + 1, &z, 10);
+
+		if (z == q + 1 || *z != '\0' || errno != 0 || labs(e) > EXP_MAX) {
+			return 0;
+		}
+
+		exp += e;
+	} else if (*q != '\0') {
+		return 0;
+	}
+
+	size = (n + LIMB_DIGITS - 1) / LIMB_DIGITS;
+	l = limbs(size);
+
+	for (k = 0; q-- > p; ) {
+		if (*q != '.') {
+			l[k / LIMB_DIGITS] += (*q - '0') * tens[k % LIMB_DIGITS];
+			k++;
+		}
+	}
+
+	*x = big(*s == '-' ? -1 : 1, exp, l, size);
+	return 1;
+}
+
+/* Append a decimal in plain notation if it has a reasonable number of
+ * digits, and in scientific notation otherwise. */
+static sds text(sds s, num *x) {
+	sds d = sdsempty();
+	long adj, k, e = x->exp;
+	int j, n;
+
+	if (x->size == 0) {
+		sdsfree(d);
+		return sdscat(s, "0");
+	}
+
+	d = sdscatprintf(d, "%u", x->limbs[x->size-1]);
+
+	for (j = x->size - 2; j >= 0; j--) {
+		d = sdscatprintf(d, "%09u", x->limbs[j]);
+	}
+
+	n = sdslen(d);
+	adj = e + n - 1;
+
+	if (x->sign < 0) {
+		s = sdscat(s, "-");
+	}
+
+	if (e <= 0 && adj >= -7) {
+		if (n + e > 0) {
+			s = sdscatlen(s, d, n + e);
+		} else {
+			s = sdscat(s, "0");
+		}
+
+		if (e < 0) {
+			s = sdscat(s, ".");
+
+			for (k = n; k < -e; k++) {
+				s = sdscat(s, "0");
+			}
+
+			s = sdscat(s, n + e > 0 ? d + n + e : d);
+		}
+	} else if (e > 0 && adj < precision) {
+		s = sdscat(s, d);
+
+		for (k = 0; k < e; k++) {
+			s = sdscat(s, "0");
+		}
+	} else {
+		s = sdscatlen(s, d, 1);
+
+		if (n > 1) {
+			s = sdscat(s, ".");
+			s = sdscat(s, d + 1);
+		}
+
+		s = sdscatprintf(s, "e%c%02ld", adj < 0 ? '-' : '+', labs(adj));
+	}
+
+	sdsfree(d);
+	return s;
+}
+
+/* Fixed point
+ *
+ * In fixed mode a number is an integer count of 10^-$CLAC_SCALE, so
+ * addition, subtraction and modulo are exact, and products and
+ * quotients are rounded half to even to the last place. Magnitudes
+ * are kept within FIXED_MAX, so negating never overflows. */
+static num scaled(fixed q) {
+	num x = {K_FIXED};
+	x.q = q;
+	return x;
+}
+
+/* A fixed point number from a magnitude and a sign, or 0 if it
+ * doesn't fit. */
+static int qfit(ufixed m, int negative, num *x) {
+	if (m > (ufixed) FIXED_MAX) {
+		return 0;
+	}
+
+	*x = scaled(negative ? -(fixed) m : (fixed) m);
+	return 1;
+}
+
+static ufixed magnitude(fixed q) {
+	return q < 0 ? -(ufixed) q : (ufixed) q;
+}
+
+/* Round a quotient half to even, given its remainder and divisor. */
+static ufixed nearest(ufixed q, ufixed r, ufixed d) {
+	return r > d - r || (r == d - r && (q & 1)) ? q + 1 : q;
+}
+
+/* floor(a * b / c) and its remainder, for a < c, without overflowing. */
+static ufixed muldiv(ufixed a, ufixed b, ufixed c, ufixed *r) {
+	ufixed q = 0, m = 0;
+	int k;
+
+	for (k = sizeof(ufixed) * 8 - 1; k >= 0; k--) {
+		q <<= 1;
+		m <<= 1;
+
+		if (m >= c) {
+			m -= c;
+			q++;
+		}
+
+		if ((b >> k) & 1) {
+			m += a;
+
+			if (m >= c) {
+				m -= c;
+				q++;
+			}
+		}
+	}
+
+	*r = m;
+	return q;
+}
+
+static int qadd(num *b, num *a, int negate, num *x) {
+	fixed y = negate ? -a->q : a->q;
+
+	if ((y > 0 && b->q > FIXED_MAX - y) || (y < 0 && b->q < -FIXED_MAX - y)) {
+		return 0;
+	}
+
+	*x = scaled(b->q + y);
+	return 1;
+}
+
+/* With x = xh * unit + xl and y = yh * unit + yl, the product is
+ * xh * y + xl * yh + xl * yl / unit, and xl * yl < unit^2 fits. */
+static int qmul(num *b, num *a, num *x) {
+	ufixed u = unit, max = FIXED_MAX;
+	ufixed m = magnitude(b->q), n = magnitude(a->q);
+	ufixed mh = m / u, ml = m % u, nh = n / u, nl = n % u;
+	ufixed p, q, t;
+
+	if (mh != 0 && n > max / mh) {
+		return 0;
+	}
+
+	p = mh * n;
+	q = ml * nh;
+	t = ml * nl;
+
+	if (q > max - p || t / u > max - p - q) {
+		return 0;
+	}
+
+	return qfit(nearest(p + q + t / u, t % u, u), (b->q < 0) != (a->q < 0), x);
+}
+
+static int qdiv(num *b, num *a, num *x) {
+	ufixed u = unit, max = FIXED_MAX;
+	ufixed m = magnitude(b->q), n = magnitude(a->q);
+	ufixed q, r, f;
+
+	if (n == 0) {
+		return 0;
+	}
+
+	q = m / n;
+	r = m % n;
+
+	if (q > max / u) {
+		return 0;
+	}
+
+	if (r <= max / u) {
+		f = r * u / n;
+		r = r * u % n;
+	} else {
+		f = muldiv(r, u, n, &r);
+	}
+
+	return qfit(nearest(q * u + f, r, n), (b->q < 0) != (a->q < 0), x);
+}
+
+static int qmod(num *b, num *a, num *x) {
+	fixed r;
+
+	if (a->q == 0) {
+		return 0;
+	}
+
+	r = b->q % a->q;
+	*x = scaled(r != 0 && (r < 0) != (a->q < 0) ? r + a->q : r);
+	return 1;
+}
+
+/* Integer powers by repeated squaring, rounding at every step. */
+static int qpow(num *b, num *a, num *x) {
+	fixed n = a->q / unit;
+	num k = scaled(unit), s = *b, t = scaled(-a->q);
+
+	if (a->q % unit != 0) {
+		return 0;
+	}
+
+	if (n < 0) {
+		return qpow(b, &t, &t) && qdiv(&k, &t, x);
+	}
+
+	while (n > 0) {
+		if ((n & 1) && !qmul(&k, &s, &k)) {
+			return 0;
+		}
+
+		n >>= 1;
+
+		if (n > 0 && !qmul(&s, &s, &s)) {
+			return 0;
+		}
+	}
+
+	*x = k;
+	return 1;
+}
+
+/* Round to a whole number, like the double functions. */
+static num qwhole(num *a, int how) {
+	fixed r = a->q % unit, q = a->q - r;
+
+	switch (how) {
+	case FLOOR:
+		return scaled(r < 0 ? q - unit : q);
+	case CEIL:
+		return scaled(r > 0 ? q + unit : q);
+	default:
+		if (2 * magnitude(r) >= (ufixed) unit) {
+			q += r < 0 ? -unit : unit;
+		}
+		return scaled(q);
+	}
+}
+
+/* Parse a decimal literal, rounding the digits past the scale half to
+ * even, or return 0 if the string isn't one or it doesn't fit. */
+static int qscan(const char *s, num *x) {
+	const char *p = s + (*s == '-' || *s == '+');
+	const char *q;
+	ufixed m = 0, max = FIXED_MAX;
+	long e = 0, pos;
+	int n = 0, ints = -1, rd = 0, sticky = 0;
+	char *z;
+
+	for (q = p; isdigit(*q) || (*q == '.' && ints < 0); q++) {
+		if (*q == '.') {
+			ints = n;
+		} else {
+			n++;
+		}
+	}
+
+	if (n == 0) {
+		return 0;
+	}
+
+	if (*q == 'e' || *q == 'E') {
+		errno = 0;
+		e = strtol(q + 1, &z, 10);
+
+		if (z == q + 1 || *z != '\0' || errno != 0 || labs(e) > EXP_MAX) {
+			return 0;
+		}
+	} else if (*q != '\0') {
+		return 0;
+	}
+
+	pos = (ints < 0 ? n : ints) - 1 + e;
+
+	for (; p < q; p++) {
+		if (*p == '.') {
+			continue;
+		}
+
+		if (pos >= -scale) {
+			if (m > (max - (*p - '0')) / 10) {
+				return 0;
+			}
+
+			m = m * 10 + (*p - '0');
+		} else if (pos == -scale - 1) {
+			rd = *p - '0';
+		} else {
+			sticky |= *p != '0';
+		}
+
+		pos--;
+	}
+
+	for (; pos >= -scale; pos--) {
+		if (m > max / 10) {
+			return 0;
+		}
+
+		m *= 10;
+	}
+
+	if (rd > 5 || (rd == 5 && (sticky || (m & 1)))) {
+		m++;
+	}
+
+	return qfit(m, *s == '-', x);
+}
+
+/* Append a fixed point number with all the digits of the scale. */
+static sds qtext(sds s, num *x) {
+	char buf[64], *p = buf + sizeof(buf);
+	ufixed m = magnitude(x->q);
+	int k;
+
+	*--p = '\0';
+
+	for (k = 0; k < scale; k++, m /= 10) {
+		*--p = '0' + m % 10;
+	}
+
+	if (scale > 0) {
+		*--p = '.';
+	}
+
+	do {
+		*--p = '0' + m % 10;
+		m /= 10;
+	} while (m != 0);
+
+	if (x->q < 0) {
+		*--p = '-';
+	}
+
+	return sdscat(s, p);
+}
+
+/* Rationals
+ *
+ * In rational mode a number is a fraction in lowest terms with a
+ * positive denominator. Both parts share the 128-bit integers of the
+ * fixed point numbers, and fractions that don't fit are doubles. */
+static int zeros(ufixed x) {
+	int k = 0;
+
+#ifdef __GNUC__
+	if ((unsigned long long) x == 0) {
+		x >>= 32;
+		x >>= 32;
+		k = 64;
+	}
+
+	return k + __builtin_ctzll((unsigned long long) x);
+#else
+	for (; (x & 1) == 0; x >>= 1) {
+		k++;
+	}
+
+	return k;
+#endif
+}
+
+/* Stein's binary GCD, switching to 64 bits as soon as both numbers
+ * fit. */
+static ufixed gcd(ufixed a, ufixed b) {
+	unsigned long long x, y;
+	ufixed t;
+	int k;
+
+	if (a == 0 || b == 0) {
+		return a | b;
+	}
+
+	k = zeros(a | b);
+	a >>= zeros(a);
+	b >>= zeros(b);
+
+	while (a > ULLONG_MAX || b > ULLONG_MAX) {
+		if (a > b) {
+			t = a;
+			a = b;
+			b = t;
+		}
+
+		b -= a;
+
+		if (b == 0) {
+			return a << k;
+		}
+
+		b >>= zeros(b);
+	}
+
+	for (x = a, y = b; x != y; y >>= zeros(y)) {
+		if (x > y) {
+			t = x;
+			x = y;
+			y = t;
+		}
+
+		y -= x;
+	}
+
+	return (ufixed) x << k;
+}
+
+static int wadd(fixed a, fixed b, fixed *r) {
+	if ((b > 0 && a > FIXED_MAX - b) || (b < 0 && a < -FIXED_MAX - b)) {
+		return 0;
+	}
+
+	*r = a + b;
+	return 1;
+}
+
+static int wmul(fixed a, fixed b, fixed *r) {
+	ufixed m = magnitude(a), n = magnitude(b);
+
+	if (m != 0 && n > (ufixed) FIXED_MAX / m) {
+		return 0;
+	}
+
+	*r = a * b;
+	return 1;
+}
+
+/* Reduce a fraction with a nonzero denominator. */
+static num ratio(fixed n, fixed d) {
+	fixed g = gcd(magnitude(n), magnitude(d));
+	num x = {K_RATIONAL};
+
+	x.q = d < 0 ? -n / g : n / g;
+	x.den = d < 0 ? -d / g : d / g;
+	return x;
+}
+
+static int radd(num *b, num *a, int negate, num *x) {
+	fixed g = gcd(b->den, a->den), n, m, d;
+
+	if (!wmul(b->q, a->den / g, &n) ||
+	    !wmul(negate ? -a->q : a->q, b->den / g, &m) ||
+	    !wmul(b->den, a->den / g, &d) || !wadd(n, m, &n)) {
+		return 0;
+	}
+
+	*x = ratio(n, d);
+	return 1;
+}
+
+/* Cancel across before multiplying, so the result is already reduced. */
+static int rmul(num *b, num *a, num *x) {
+	fixed g, h;
+
+	if (b->q == 0 || a->q == 0) {
+		*x = ratio(0, 1);
+		return 1;
+	}
+
+	g = gcd(magnitude(b->q), a->den);
+	h = gcd(magnitude(a->q), b->den);
+
+	x->kind = K_RATIONAL;
+	return wmul(b->q / g, a->q / h, &x->q) &&
+		wmul(b->den / h, a->den / g, &x->den);
+}
+
+static int rdiv(num *b, num *a, num *x) {
+	num r;
+
+	if (a->q == 0) {
+		return 0;
+	}
+
+	r = ratio(a->den, a->q);
+	return rmul(b, &r, x);
+}
+
+/* Round to a whole number, like the double functions. */
+static num rwhole(num *a, int how) {
+	fixed q = a->q / a->den, r = a->q % a->den;
+
+	switch (how) {
+	case FLOOR:
+		return ratio(r < 0 ? q - 1 : q, 1);
+	case CEIL:
+		return ratio(r > 0 ? q + 1 : q, 1);
+	default:
+		if (magnitude(r) >= a->den - magnitude(r)) {
+			q += r < 0 ? -1 : 1;
+		}
+		return ratio(q, 1);
+	}
+}
+
+static int rmod(num *b, num *a, num *x) {
+	num t;
+
+	if (!rdiv(b, a, &t)) {
+		return 0;
+	}
+
+	t = rwhole(&t, FLOOR);
+	return rmul(a, &t, &t) && radd(b, &t, 1, x);
+}
+
+/* Integer powers raise both parts, which stay coprime. */
+static int rpow(num *b, num *a, num *x) {
+	fixed n = a->q;
+	num k = ratio(1, 1), s = *b;
+
+	if (a->den != 1 || (n < 0 && b->q == 0)) {
+		return 0;
+	}
+
+	if (n < 0) {
+		s = ratio(b->den, b->q);
+		n = -n;
+	}
+
+	while (n > 0) {
+		if ((n & 1) && !(wmul(k.q, s.q, &k.q) && wmul(k.den, s.den, &k.den))) {
+			return 0;
+		}
+
+		n >>= 1;
+
+		if (n > 0 && !(wmul(s.q, s.q, &s.q) && wmul(s.den, s.den, &s.den))) {
+			return 0;
+		}
+	}
+
+	*x = k;
+	return 1;
+}
+
+/* Append a 128-bit integer. */
+static sds wtext(sds s, fixed n) {
+	char buf[48], *p = buf + sizeof(buf);
+	ufixed m = magnitude(n);
+
+	*--p = '\0';
+
+	do {
+		*--p = '0' + m % 10;
+		m /= 10;
+	} while (m != 0);
+
+	if (n < 0) {
+		*--p = '-';
+	}
+
+	return sdscat(s, p);
+}
+
+/* Parse a decimal literal as an exact fraction, or return 0 if the
+ * string isn't one or it doesn't fit. */
+static int rscan(const char *s, num *x) {
+	const char *p = s + (*s == '-' || *s == '+');
+	fixed n = 0, d = 1;
+	long e = 0;
+	int digits = 0, point = 0;
+	char *z;
+
+	for (; isdigit(*p) || (*p == '.' && !point); p++) {
+		if (*p == '.') {
+			point = 1;
+		} else if (!wmul(n, 10, &n) || !wadd(n, *p - '0', &n)) {
+			return 0;
+		} else {
+			digits++;
+			e -= point;
+		}
+	}
+
+	if (digits == 0) {
+		return 0;
+	}
+
+	if (*p == 'e' || *p == 'E') {
+		errno = 0;
+		e += strtol(p + 1, &z, 10);
+
+		if (z == p + 1 || *z != '\0' || errno != 0 || labs(e) > EXP_MAX) {
+			return 0;
+		}
+	} else if (*p != '\0') {
+		return 0;
+	}
+
+	for (; e > 0 && n != 0; e--) {
+		if (!wmul(n, 10, &n)) {
+			return 0;
+		}
+	}
+
+	for (; e < 0; e++) {
+		if (!wmul(d, 10, &d)) {
+			return 0;
+		}
+	}
+
+	*x = ratio(*s == '-' ? -n : n, d);
+	return 1;
+}
+
+/* Integer arithmetic that fails instead of overflowing. */
+static int iadd(long long a, long long b, long long *r) {
+	if ((b > 0 && a > LLONG_MAX - b) || (b < 0 && a < LLONG_MIN - b)) {
+		return 0;
+	}
+
+	*r = a + b;
+	return 1;
+}
+
+static int isub(long long a, long long b, long long *r) {
+	if ((b < 0 && a > LLONG_MAX + b) || (b > 0 && a < LLONG_MIN + b)) {
+		return 0;
+	}
+
+	*r = a - b;
+	return 1;
+}
+
+static int imul(long long a, long long b, long long *r) {
+	unsigned long long x = a < 0 ? -(unsigned long long) a : a;
+	unsigned long long y = b < 0 ? -(unsigned long long) b : b;
+	unsigned long long max = LLONG_MAX;
+	int negative = (a < 0) != (b < 0);
+
+	if (y != 0 && x > (max + negative) / y) {
+		return 0;
+	}
+
+	*r = negative ? (long long) -(x * y) : (long long) (x * y);
+	return 1;
+}
+
+static int ipow(long long a, long long b, long long *r) {
+	long long k = 1;
+
+	while (b > 0) {
+		if ((b & 1) && !imul(k, a, &k)) {
+			return 0;
+		}
+
+		b >>= 1;
+
+		if (b > 0 && !imul(a, a, &a)) {
+			return 0;
+		}
+	}
+
+	*r = k;
+	return 1;
+}
+
+static num inexact(double d) {
+	num x = {K_REAL, 0, d};
+	return x;
+}
+
+static num integer(long long i) {
+	unsigned long long u = i < 0 ? -(unsigned long long) i : i;
+	num x = {K_INT, i, 0};
+	unsigned *l;
+
+	if (mode == MODE_DECIMAL) {
+		l = limbs(3);
+		l[0] = u % LIMB_BASE;
+		l[1] = u / LIMB_BASE % LIMB_BASE;
+		l[2] = u / LIMB_BASE / LIMB_BASE;
+		return big(i < 0 ? -1 : 1, 0, l, 3);
+	}
+
+	if (mode == MODE_FIXED) {
+		x = inexact(i);
+
+		if (u <= (ufixed) FIXED_MAX / unit) {
+			qfit(u * unit, i < 0, &x);
+		}
+	}
+
+	if (mode == MODE_RATIONAL) {
+		x = ratio(i, 1);
+	}
+
+	return x;
+}
+
+/* A double as the kind of number of the current mode, if possible.
+ * Decimals get the shortest digits that read back as the same double,
+ * fixed point numbers are rounded to the scale, and rationals below
+ * 2^53 are exact. */
+static num approx(double d) {
+	char buf[64];
+	fixed n, k;
+	num x;
+	int p, e;
+
+	if (mode == MODE_RATIONAL && fabs(d) < 9007199254740992.0) {
+		n = ldexp(frexp(d, &e), 53);
+
+		for (e -= 53; e < 0 && n % 2 == 0; e++) {
+			n /= 2;
+		}
+
+		for (k = 1; e < 0 && wmul(k, 2, &k); e++);
+
+		return e == 0 ? ratio(n, k) : inexact(d);
+	}
+
+	if (mode == MODE_FIXED && fabs(d) < (double) FIXED_MAX / unit) {
+		snprintf(buf, sizeof(buf), "%.*f", scale, d);
+		return qscan(buf, &x) ? x : inexact(d);
+	}
+
+	if (mode != MODE_DECIMAL || !isfinite(d)) {
+		return inexact(d);
+	}
+
+	for (p = 15; ; p++) {
+		snprintf(buf, sizeof(buf), "%.*g", p, d);
+
+		if (p == 17 || strtod(buf, NULL) == d) {
+			break;
+		}
+	}
+
+	scan(buf, &x);
+	return x;
+}
+
+static double value(num *x) {
+	sds s;
+	double d;
+
+	if (x->kind == K_BIG) {
+		s = text(sdsempty(), x);
+		d = strtod(s, NULL);
+		sdsfree(s);
+		return d;
+	}
+
+	if (x->kind == K_FIXED) {
+		return (long double) x->q / unit;
+	}
+
+	if (x->kind == K_RATIONAL) {
+		return (long double) x->q / x->den;
+	}
+
+	return x->kind == K_INT ? (double) x->i : x->d;
+}
+
+/* Round a decimal to an integer. */
+static num whole(num *x, int how) {
+	return x->exp < 0 ? chop(copy(x), -x->exp, how) : copy(x);
+}
+
+/* Truncate a number to an integer, if it's in range. */
+static int toint(num *x, long long *i) {
+	long long r = 0;
+	num t;
+	int k, ok;
+
+	if (x->kind == K_INT) {
+		*i = x->i;
+		return 1;
+	}
+
+	if (x->kind == K_BIG) {
+		t = whole(x, TRUNC);
+		ok = top(&t) <= 19;
+
+		for (k = t.size - 1; ok && k >= 0; k--) {
+			ok = imul(r, LIMB_BASE, &r) && iadd(r, t.limbs[k], &r);
+		}
+
+		for (k = 0; ok && k < t.exp; k++) {
+			ok = imul(r, 10, &r);
+		}
+
+		*i = t.sign * r;
+		release(&t);
+		return ok;
+	}
+
+	if (x->kind == K_FIXED) {
+		*i = x->q / unit;
+		return x->q / unit == *i;
+	}
+
+	if (x->kind == K_RATIONAL) {
+		*i = x->q / x->den;
+		return x->q / x->den == *i;
+	}
+
+	if (x->d >= -9223372036854775808.0 && x->d < 9223372036854775808.0) {
+		*i = (long long) x->d;
+		return 1;
+	}
+
+	return 0;
+}
+
+/* An integer if the double is a whole number in range. */
+static num rounded(double d) {
+	num x = inexact(d);
+	long long i;
+
+	if (d == floor(d) && mode == MODE_DECIMAL) {
+		return approx(d);
+	}
+
+	if (d == floor(d) && toint(&x, &i)) {
+		return integer(i);
+	}
+
+	return x;
+}
+
+static num number(const char *s) {
+	const char *p = s + (*s == '-' || *s == '+');
+	long long i;
+	char *z;
+	num x;
+
+	if (mode == MODE_DECIMAL && scan(s, &x)) {
+		return x;
+	}
+
+	if (mode == MODE_FIXED && qscan(s, &x)) {
+		return x;
+	}
+
+	if (mode == MODE_RATIONAL && rscan(s, &x)) {
+		return x;
+	}
+
+	errno = 0;
+	i = strtoll(s, &z, p[0] == '0' && tolower(p[1]) == 'x' ? 16 : 10);
+
+	if (*z == '\0' && z != s && errno == 0) {
+		return integer(i);
+	}
+
+	return inexact(strtod(s, NULL));
+}
+
+static sds format(sds s, double x) {
+	num *n;
+
+	if (mode == MODE_DOUBLE) {
+		return sdscatprintf(s, NUMBER_FMT, x);
+	}
+
+	n = unbox(x);
+
+	if (n->kind == K_INT) {
+		return sdscatprintf(s, "%lld", n->i);
+	}
+
+	if (n->kind == K_BIG) {
+		return text(s, n);
+	}
+
+	if (n->kind == K_FIXED) {
+		return qtext(s, n);
+	}
+
+	if (n->kind == K_RATIONAL && n->den == 1) {
+		return wtext(s, n->q);
+	}
+
+	if (n->kind == K_RATIONAL) {
+		return sdscatprintf(s, NUMBER_FMT, value(n));
+	}
+
+	return sdscatprintf(s, NUMBER_FMT, n->d);
+}
+
+/* Multiply by a power of two, clamping the exponent to what ldexp can
+ * take, so shifting a double behaves like shifting an integer. */
+static double shift(double b, double a) {
+	if (isnan(a)) {
+		return NAN;
+	}
+
+	return ldexp(b, a > 2100 ? 2100 : a < -2100 ? -2100 : (int) a);
+}
+
+static int popcount(unsigned long long x) {
+	int k;
+
+	for (k = 0; x != 0; k++) {
+		x &= x - 1;
+	}
+
+	return k;
+}
+
+/* The factorials that fit in a double, correctly rounded. */
+static const double factorials[] = {
+	1, 1, 2, 6, 24, 120, 720, 5040, 40320, 362880, 3628800,
+	39916800, 479001600, 6227020800, 87178291200, 1307674368000,
+	20922789888000, 355687428096000, 6402373705728000,
+	1.21645100408832e+17, 2.43290200817664e+18,
+	5.109094217170944e+19, 1.1240007277776077e+21,
+	2.585201673888498e+22, 6.204484017332394e+23,
+	1.5511210043330986e+25, 4.0329146112660565e+26,
+	1.0888869450418352e+28, 3.0488834461171387e+29,
+	8.841761993739702e+30, 2.6525285981219107e+32,
+	8.222838654177922e+33, 2.631308369336935e+35,
+	8.683317618811886e+36, 2.9523279903960416e+38,
+	1.0333147966386145e+40, 3.7199332678990125e+41,
+	1.3763753091226346e+43, 5.230226174666011e+44,
+	2.0397882081197444e+46, 8.159152832478977e+47,
+	3.345252661316381e+49, 1.40500611775288e+51,
+	6.041526306337383e+52, 2.658271574788449e+54,
+	1.1962222086548019e+56, 5.502622159812089e+57,
+	2.5862324151116818e+59, 1.2413915592536073e+61,
+	6.082818640342675e+62, 3.0414093201713376e+64,
+	1.5511187532873822e+66, 8.065817517094388e+67,
+	4.2748832840600255e+69, 2.308436973392414e+71,
+	1.2696403353658276e+73, 7.109985878048635e+74,
+	4.0526919504877214e+76, 2.3505613312828785e+78,
+	1.3868311854568984e+80, 8.32098711274139e+81,
+	5.075802138772248e+83, 3.146997326038794e+85,
+	1.98260831540444e+87, 1.2688693218588417e+89,
+	8.247650592082472e+90, 5.443449390774431e+92,
+	3.647111091818868e+94, 2.4800355424368305e+96,
+	1.711224524281413e+98, 1.1978571669969892e+100,
+	8.504785885678623e+101, 6.1234458376886085e+103,
+	4.4701154615126844e+105, 3.307885441519386e+107,
+	2.48091408113954e+109, 1.8854947016660504e+111,
+	1.4518309202828587e+113, 1.1324281178206297e+115,
+	8.946182130782976e+116, 7.156945704626381e+118,
+	5.797126020747368e+120, 4.753643337012842e+122,
+	3.945523969720659e+124, 3.314240134565353e+126,
+	2.81710411438055e+128, 2.4227095383672734e+130,
+	2.107757298379528e+132, 1.8548264225739844e+134,
+	1.650795516090846e+136, 1.4857159644817615e+138,
+	1.352001527678403e+140, 1.2438414054641308e+142,
+	1.1567725070816416e+144, 1.087366156656743e+146,
+	1.032997848823906e+148, 9.916779348709496e+149,
+	9.619275968248212e+151, 9.426890448883248e+153,
+	9.332621544394415e+155, 9.332621544394415e+157,
+	9.42594775983836e+159, 9.614466715035127e+161,
+	9.90290071648618e+163, 1.0299016745145628e+166,
+	1.081396758240291e+168, 1.1462805637347084e+170,
+	1.226520203196138e+172, 1.324641819451829e+174,
+	1.4438595832024937e+176, 1.588245541522743e+178,
+	1.7629525510902446e+180, 1.974506857221074e+182,
+	2.2311927486598138e+184, 2.5435597334721877e+186,
+	2.925093693493016e+188, 3.393108684451898e+190,
+	3.969937160808721e+192, 4.684525849754291e+194,
+	5.574585761207606e+196, 6.689502913449127e+198,
+	8.094298525273444e+200, 9.875044200833601e+202,
+	1.214630436702533e+205, 1.506141741511141e+207,
+	1.882677176888926e+209, 2.372173242880047e+211,
+	3.0126600184576594e+213, 3.856204823625804e+215,
+	4.974504222477287e+217, 6.466855489220474e+219,
+	8.47158069087882e+221, 1.1182486511960043e+224,
+	1.4872707060906857e+226, 1.9929427461615188e+228,
+	2.6904727073180504e+230, 3.659042881952549e+232,
+	5.012888748274992e+234, 6.917786472619489e+236,
+	9.615723196941089e+238, 1.3462012475717526e+241,
+	1.898143759076171e+243, 2.695364137888163e+245,
+	3.854370717180073e+247, 5.5502938327393044e+249,
+	8.047926057471992e+251, 1.1749972043909107e+254,
+	1.727245890454639e+256, 2.5563239178728654e+258,
+	3.80892263763057e+260, 5.713383956445855e+262,
+	8.62720977423324e+264, 1.3113358856834524e+267,
+	2.0063439050956823e+269, 3.0897696138473508e+271,
+	4.789142901463394e+273, 7.471062926282894e+275,
+	1.1729568794264145e+278, 1.853271869493735e+280,
+	2.9467022724950384e+282, 4.7147236359920616e+284,
+	7.590705053947219e+286, 1.2296942187394494e+289,
+	2.0044015765453026e+291, 3.287218585534296e+293,
+	5.423910666131589e+295, 9.003691705778438e+297,
+	1.503616514864999e+300, 2.5260757449731984e+302,
+	4.269068009004705e+304, 7.257415615307999e+306
+};
+
+/* Factorials of integers come from the table, and other numbers go
+ * through the gamma function. */
+static double factorial(double a) {
+	if (a >= 0 && a <= 170 && a == floor(a)) {
+		return factorials[(int) a];
+	}
+
+	return a * tgamma(a);
+}
+
+/* Binomial coefficients of integers multiply and divide in turns, so
+ * the partial results are binomial coefficients too and only overflow
+ * when the result does. Negative integers use the upper negation
+ * identity, and other numbers go through log-gamma. */
+static double choose(double n, double k) {
+	double r = 1, j;
+
+	if (n != floor(n) || k != floor(k)) {
+		return exp(lgamma(n + 1) - lgamma(k + 1) - lgamma(n - k + 1));
+	}
+
+	if (k < 0 || (k > n && n >= 0)) {
+		return 0;
+	}
+
+	if (n < 0) {
+		return (fmod(k, 2) == 0 ? 1 : -1) * choose(k - n - 1, k);
+	}
+
+	if (k > n - k) {
+		k = n - k;
+	}
+
+	for (j = 1; j <= k && !isinf(r); j++) {
+		r = r * (n - k + j) / j;
+	}
+
+	return r;
+}
+
+/* The operations on doubles, for numbers that aren't exact. */
+static double apply(int op, double b, double a) {
+	switch (op) {
+	case OP_ADD: return b + a;
+	case OP_SUB: return b - a;
+	case OP_MUL: return b * a;
+	case OP_DIV: return b / a;
+	case OP_MOD: return modulo(b, a);
+	case OP_POW: return pow(b, a);
+	case OP_SHL: return shift(b, a);
+	case OP_SHR: return floor(shift(b, -a));
+	case OP_ABS: return fabs(a);
+	case OP_CEIL: return ceil(a);
+	case OP_FLOOR: return floor(a);
+	case OP_ROUND: return round(a);
+	case OP_SIN: return sin(a);
+	case OP_COS: return cos(a);
+	case OP_TAN: return tan(a);
+	case OP_ASIN: return asin(a);
+	case OP_ACOS: return acos(a);
+	case OP_ATAN: return atan(a);
+	case OP_ATAN2: return atan2(b, a);
+	case OP_LN: return log(a);
+	case OP_LOG: return log10(a);
+	case OP_ERF: return erf(a);
+	case OP_FACT: return factorial(a);
+	case OP_CHOOSE: return choose(b, a);
+	case OP_LGAMMA: return lgamma(a);
+	}
+
+	return NAN;
+}
+
+/* Copy the coefficient of a decimal multiplied by 10^k, with room for
+ * a carry. */
+static unsigned *mscale(num *x, long k, int *n) {
+	unsigned long long carry = 0;
+	unsigned *l;
+	int j, q = k / LIMB_DIGITS;
+
+	*n = x->size + q + 2;
+	l = limbs(*n);
+	memcpy(l + q, x->limbs, x->size * sizeof(unsigned));
+
+	for (j = q; j < *n; j++) {
+		carry += (unsigned long long) l[j] * tens[k % LIMB_DIGITS];
+		l[j] = carry % LIMB_BASE;
+		carry /= LIMB_BASE;
+	}
+
+	return l;
+}
+
+/* Compare two decimals, or their magnitudes. */
+static int dcmp(num *b, num *a, int magnitude) {
+	int sb = b->size == 0 ? 0 : magnitude ? 1 : b->sign;
+	int sa = a->size == 0 ? 0 : magnitude ? 1 : a->sign;
+	long e = b->exp < a->exp ? b->exp : a->exp;
+	unsigned *x, *y;
+	int c, nx, ny;
+
+	if (sb != sa || sb == 0) {
+		return (sb > sa) - (sb < sa);
+	}
+
+	if (top(b) != top(a)) {
+		return top(b) > top(a) ? sb : -sb;
+	}
+
+	x = mscale(b, b->exp - e, &nx);
+	y = mscale(a, a->exp - e, &ny);
+	c = mcmp(x, nx, y, ny);
+
+	free(x);
+	free(y);
+
+	return c * sb;
+}
+
+/* Add or subtract two decimals exactly. */
+static num dadd(num *b, num *a, int negate) {
+	long e = b->exp < a->exp ? b->exp : a->exp;
+	int sa = negate ? -a->sign : a->sign, sign = b->sign;
+	int nx, ny, k;
+	unsigned *x, *y, *t;
+	num r;
+
+	if (b->size == 0) {
+		r = copy(a);
+		r.sign = sa;
+		return r;
+	}
+
+	if (a->size == 0) {
+		return copy(b);
+	}
+
+	x = mscale(b, b->exp - e, &nx);
+	y = mscale(a, a->exp - e, &ny);
+
+	if (sa != sign && mcmp(x, nx, y, ny) < 0) {
+		sign = sa;
+		t = x; x = y; y = t;
+		k = nx; nx = ny; ny = k;
+	}
+
+	if (sa == b->sign) {
+		if (ny > nx) {
+			t = x; x = y; y = t;
+			k = nx; nx = ny; ny = k;
+		}
+
+		macc(x, nx, y, ny);
+	} else {
+		mdec(x, nx, y, ny);
+	}
+
+	free(y);
+
+	return big(sign, e, x, nx);
+}
+
+/* Add or subtract two decimals, rounded. An operand that is entirely
+ * below the rounding position of the other one only matters for the
+ * rounding, so it's replaced by a single digit below that position. */
+static num plus(num *b, num *a, int negate) {
+	num *x = top(a) > top(b) ? a : b;
+	num *y = x == a ? b : a;
+	long limit = top(x) - precision - 2;
+	unsigned *l;
+	num r, t;
+
+	if (x->exp < limit) {
+		limit = x->exp;
+	}
+
+	if (a->size == 0 || b->size == 0 || top(y) > limit) {
+		return fit(dadd(b, a, negate));
+	}
+
+	l = limbs(1);
+	l[0] = 1;
+	t = big(y->sign, limit - 1, l, 1);
+	r = y == a ? dadd(b, &t, negate) : dadd(&t, a, negate);
+	release(&t);
+
+	return fit(r);
+}
+
+static num dmul(num *b, num *a) {
+	unsigned *l = limbs(b->size + a->size);
+
+	mmul(l, b->limbs, b->size, a->limbs, a->size);
+
+	return big(b->sign * a->sign, b->exp + a->exp, l, b->size + a->size);
+}
+
+/* Approximate 1 / a to p digits, starting from the reciprocal as a
+ * double and doubling the number of correct digits with each step of
+ * Newton's iteration x = x + x (1 - a x). */
+static num reciprocal(num *a, int p) {
+	num m = fitto(copy(a), p + 2), one = integer(1), x, t, e;
+	long shift = top(&m) - 1;
+	int k = 15;
+
+	m.exp -= shift;
+	x = approx(1 / value(&m));
+
+	do {
+		k = 2 * k < p + 2 ? 2 * k : p + 2;
+
+		t = fitto(dmul(&m, &x), k + 2);
+		e = dadd(&one, &t, 1);
+		release(&t);
+
+		t = fitto(dmul(&x, &e), k + 2);
+		release(&e);
+
+		e = dadd(&x, &t, 0);
+		release(&t);
+		release(&x);
+
+		x = fitto(e, k + 2);
+	} while (k < p + 2);
+
+	x.exp -= shift;
+
+	release(&m);
+	release(&one);
+
+	return x;
+}
+
+/* Divide b by a through the reciprocal of a, and correct the last
+ * digit of the quotient with the remainder, so it's rounded to the
+ * nearest. */
+static num ddiv(num *b, num *a) {
+	num q, r, t, u;
+	unsigned *l;
+	long ulp;
+	int c;
+
+	if (a->size == 0) {
+		return inexact(b->size == 0 ? NAN : b->sign * INFINITY);
+	}
+
+	if (b->size == 0) {
+		return integer(0);
+	}
+
+	r = reciprocal(a, precision + GUARD);
+	q = fit(dmul(b, &r));
+	release(&r);
+
+	t = dmul(&q, a);
+	r = dadd(b, &t, 1);
+	release(&t);
+
+	if (r.size > 0) {
+		ulp = top(&q) - precision;
+		t = dadd(&r, &r, 0);
+		u = copy(a);
+		u.exp += ulp;
+		c = dcmp(&t, &u, 1);
+
+		if (c > 0 || (c == 0 && digit(&q, ulp - q.exp) % 2)) {
+			l = limbs(1);
+			l[0] = 1;
+			release(&u);
+			u = big(r.sign * a->sign, ulp, l, 1);
+			release(&t);
+			t = dadd(&q, &u, 0);
+			release(&q);
+			q = fit(t);
+		} else {
+			release(&t);
+		}
+
+		release(&u);
+	}
+
+	release(&r);
+
+	return q;
+}
+
+/* The remainder of the division of b by a, with the sign of a. The
+ * integer quotient is estimated through the reciprocal, and the
+ * remainder is brought in range if the estimate was off. */
+static num dmod(num *b, num *a) {
+	long p = top(b) - top(a) + GUARD;
+	num q, r, t;
+
+	if (a->size == 0) {
+		return inexact(NAN);
+	}
+
+	if (p > EXP_MAX / 1000) {
+		return approx(apply(OP_MOD, value(b), value(a)));
+	}
+
+	r = reciprocal(a, p > GUARD ? p : GUARD);
+	t = dmul(b, &r);
+	release(&r);
+
+	t = fitto(t, p > GUARD ? p : GUARD);
+	q = whole(&t, FLOOR);
+	release(&t);
+
+	t = dmul(a, &q);
+	r = dadd(b, &t, 1);
+	release(&t);
+	release(&q);
+
+	while (r.size > 0 && (r.sign != a->sign || dcmp(&r, a, 1) >= 0)) {
+		t = dadd(&r, a, r.sign == a->sign);
+		release(&r);
+		r = t;
+	}
+
+	return fit(r);
+}
+
+/* Raise a decimal to an integer power by repeated squaring, with guard
+ * digits for the intermediate products. Other powers go through
+ * doubles. */
+static num dpow(num *b, num *a) {
+	num r, x, t;
+	long long y, k;
+
+	if (a->exp < 0 || !toint(a, &y) || y > EXP_MAX || y < -EXP_MAX) {
+		return approx(apply(OP_POW, value(b), value(a)));
+	}
+
+	r = integer(1);
+	x = copy(b);
+
+	for (k = y < 0 ? -y : y; k > 0; k >>= 1) {
+		if (k & 1) {
+			t = fitto(dmul(&r, &x), precision + GUARD);
+			release(&r);
+			r = t;
+		}
+
+		if (k > 1) {
+			t = fitto(dmul(&x, &x), precision + GUARD);
+			release(&x);
+			x = t;
+		}
+	}
+
+	release(&x);
+
+	if (y < 0) {
+		x = integer(1);
+		t = ddiv(&x, &r);
+		release(&x);
+		release(&r);
+		return t;
+	}
+
+	return fit(r);
+}
+
+static num dfact(long long n) {
+	num r = integer(1), x, t;
+	long long k;
+
+	for (k = 2; k <= n; k++) {
+		x = integer(k);
+		t = fitto(dmul(&r, &x), precision + GUARD);
+		release(&x);
+		release(&r);
+		r = t;
+	}
+
+	return fit(r);
+}
+
+static num unary(int op, num *a) {
+	long long i, k;
+	num x, y;
+
+	if (a->kind == K_INT) {
+		switch (op) {
+		case OP_ABS:
+			if (a->i != LLONG_MIN) {
+				return integer(a->i < 0 ? -a->i : a->i);
+			}
+			break;
+		case OP_CEIL:
+		case OP_FLOOR:
+		case OP_ROUND:
+			return *a;
+		case OP_FACT:
+			for (i = 2, k = 1; i <= a->i && imul(k, i, &k); i++);
+
+			if (a->i >= 0 && i > a->i) {
+				return integer(k);
+			}
+			break;
+		}
+	}
+
+	if (a->kind == K_BIG) {
+		switch (op) {
+		case OP_ABS:
+			x = copy(a);
+			x.sign = 1;
+			return x;
+		case OP_CEIL:
+			return whole(a, CEIL);
+		case OP_FLOOR:
+			return whole(a, FLOOR);
+		case OP_ROUND:
+			return whole(a, HALF_UP);
+		case OP_FACT:
+			if (a->exp >= 0 && toint(a, &i) && i >= 0 && i <= FACT_MAX) {
+				return dfact(i);
+			}
+			break;
+		}
+	}
+
+	if (a->kind == K_FIXED) {
+		switch (op) {
+		case OP_ABS:
+			return scaled(a->q < 0 ? -a->q : a->q);
+		case OP_CEIL:
+			return qwhole(a, CEIL);
+		case OP_FLOOR:
+			return qwhole(a, FLOOR);
+		case OP_ROUND:
+			return qwhole(a, HALF_UP);
+		case OP_FACT:
+			if (a->q % unit == 0 && toint(a, &i) && i >= 0) {
+				for (k = 2, x = scaled(unit); k <= i; k++) {
+					y = integer(k);
+
+					if (!qmul(&x, &y, &x)) {
+						break;
+					}
+				}
+
+				if (k > i) {
+					return x;
+				}
+			}
+			break;
+		}
+	}
+
+	if (a->kind == K_RATIONAL) {
+		switch (op) {
+		case OP_ABS:
+			return ratio(a->q < 0 ? -a->q : a->q, a->den);
+		case OP_CEIL:
+			return rwhole(a, CEIL);
+		case OP_FLOOR:
+			return rwhole(a, FLOOR);
+		case OP_ROUND:
+			return rwhole(a, HALF_UP);
+		case OP_FACT:
+			for (k = 1, x = ratio(1, 1); a->den == 1 && k <= a->q; k++) {
+				if (!wmul(x.q, k, &x.q)) {
+					break;
+				}
+			}
+
+			if (a->den == 1 && a->q >= 0 && k > a->q) {
+				return x;
+			}
+			break;
+		}
+	}
+
+	switch (op) {
+	case OP_CEIL:
+	case OP_FLOOR:
+	case OP_ROUND:
+		return rounded(apply(op, 0, a->d));
+	case OP_POPCOUNT:
+		if (toint(a, &i)) {
+			return integer(popcount(i));
+		}
+		return inexact(NAN);
+	}
+
+	return approx(apply(op, 0, value(a)));
+}
+
+/* Compare two numbers exactly, or return 2 if they are unordered. */
+static int compare(num *b, num *a) {
+	long double x, y;
+	fixed m, n;
+
+	if (b->kind == K_INT && a->kind == K_INT) {
+		return (b->i > a->i) - (b->i < a->i);
+	}
+
+	if (b->kind == K_BIG && a->kind == K_BIG) {
+		return dcmp(b, a, 0);
+	}
+
+	if (b->kind == K_FIXED && a->kind == K_FIXED) {
+		return (b->q > a->q) - (b->q < a->q);
+	}
+
+	if (b->kind == K_RATIONAL && a->kind == K_RATIONAL &&
+	    wmul(b->q, a->den, &m) && wmul(a->q, b->den, &n)) {
+		return (m > n) - (m < n);
+	}
+
+	x = b->kind == K_INT ? (long double) b->i : value(b);
+	y = a->kind == K_INT ? (long double) a->i : value(a);
+
+	if (isnan(x) || isnan(y)) {
+		return 2;
+	}
+
+	return (x > y) - (x < y);
+}
+
+static num binary(int op, num *b, num *a) {
+	long long x, y, r, j, g;
+	int c, ok = 0;
+	num n;
+
+	if (op >= OP_LT && op <= OP_NE) {
+		c = compare(b, a);
+
+		switch (op) {
+		case OP_LT: return integer(c == -1);
+		case OP_GT: return integer(c == 1);
+		case OP_LE: return integer(c == -1 || c == 0);
+		case OP_GE: return integer(c == 1 || c == 0);
+		case OP_EQ: return integer(c == 0);
+		case OP_NE: return integer(c != 0);
+		}
+	}
+
+	if (b->kind == K_INT && a->kind == K_INT) {
+		x = b->i;
+		y = a->i;
+
+		switch (op) {
+		case OP_ADD:
+			if (iadd(x, y, &r)) {
+				return integer(r);
+			}
+			break;
+		case OP_SUB:
+			if (isub(x, y, &r)) {
+				return integer(r);
+			}
+			break;
+		case OP_MUL:
+			if (imul(x, y, &r)) {
+				return integer(r);
+			}
+			break;
+		case OP_DIV:
+			if (y != 0 && (y != -1 || x != LLONG_MIN) && x % y == 0) {
+				return integer(x / y);
+			}
+			break;
+		case OP_MOD:
+			if (y == -1) {
+				return integer(0);
+			}
+
+			if (y != 0) {
+				r = x % y;
+				return integer(r != 0 && (r < 0) != (y < 0) ? r + y : r);
+			}
+			break;
+		case OP_POW:
+			if (y >= 0 && ipow(x, y, &r)) {
+				return integer(r);
+			}
+			break;
+		case OP_CHOOSE:
+			if (x >= 0 && (y < 0 || y > x)) {
+				return integer(0);
+			}
+
+			y = y > x - y ? x - y : y;
+
+			for (j = 1, r = 1; x >= 0 && j <= y; j++) {
+				g = gcd(r, j);
+
+				if (!imul(r / g, (x - y + j) / (j / g), &r)) {
+					break;
+				}
+			}
+
+			if (x >= 0 && j > y) {
+				return integer(r);
+			}
+			break;
+		}
+	}
+
+	if (b->kind == K_BIG && a->kind == K_BIG) {
+		switch (op) {
+		case OP_ADD: return plus(b, a, 0);
+		case OP_SUB: return plus(b, a, 1);
+		case OP_MUL: return fit(dmul(b, a));
+		case OP_DIV: return ddiv(b, a);
+		case OP_MOD: return dmod(b, a);
+		case OP_POW: return dpow(b, a);
+		}
+	}
+
+	if (b->kind == K_FIXED && a->kind == K_FIXED) {
+		switch (op) {
+		case OP_ADD: ok = qadd(b, a, 0, &n); break;
+		case OP_SUB: ok = qadd(b, a, 1, &n); break;
+		case OP_MUL: ok = qmul(b, a, &n); break;
+		case OP_DIV: ok = qdiv(b, a, &n); break;
+		case OP_MOD: ok = qmod(b, a, &n); break;
+		case OP_POW: ok = qpow(b, a, &n); break;
+		}
+
+		if (ok) {
+			return n;
+		}
+	}
+
+	if (b->kind == K_RATIONAL && a->kind == K_RATIONAL) {
+		switch (op) {
+		case OP_ADD: ok = radd(b, a, 0, &n); break;
+		case OP_SUB: ok = radd(b, a, 1, &n); break;
+		case OP_MUL: ok = rmul(b, a, &n); break;
+		case OP_DIV: ok = rdiv(b, a, &n); break;
+		case OP_MOD: ok = rmod(b, a, &n); break;
+		case OP_POW: ok = rpow(b, a, &n); break;
+		}
+
+		if (ok) {
+			return n;
+		}
+	}
+
+	switch (op) {
+	case OP_OR:
+	case OP_AND:
+	case OP_XOR:
+	case OP_SHL:
+	case OP_SHR:
+		if (!toint(b, &x) || !toint(a, &y)) {
+			return inexact(NAN);
+		}
+
+		switch (op) {
+		case OP_OR: return integer(x | y);
+		case OP_AND: return integer(x & y);
+		case OP_XOR: return integer(x ^ y);
+		}
+
+		if (op == OP_SHR) {
+			y = -y;
+		}
+
+		if (y <= -64) {
+			return integer(x < 0 ? -1 : 0);
+		}
+
+		if (y < 0) {
+			return integer(x < 0 ? ~(~x >> -y) : x >> -y);
+		}
+
+		/* Bits shifted out overflow, like a sum or a product. */
+		if (y < 64) {
+			r = (long long) ((unsigned long long) x << y);
+
+			if (r >> y == x) {
+				return integer(r);
+			}
+		}
+	}
+
+	return approx(apply(op, value(b), value(a)));
+}
+
+/* Replace the top n items with their sum or product, in the same order
+ * as add and mul. Partial results go to the arena, like any other. */
+static void total(int op, double n) {
+	double a = pop(s0);
+
+	while (!isempty(s0) && n > 1) {
+		a = box(binary(op, unbox(a), unbox(pop(s0))));
+		n--;
+	}
+
+	push(s0, a);
+}
+
+static void sequence(double a, double step, double n) {
+	int j;
+
+	for (j = 0; j < n && !isoverflow(s0); j++) {
+		push(s0, box(rounded(a + j * step)));
+	}
+}
+
+/* Statistics work on doubles, except for min and max, which keep the
+ * extreme number as it is. */
+static void tally(int op) {
+	double x, y, p = 0;
+	stack t;
+	int j;
+
+	if (op == OP_PERCENTILE) {
+		p = value(unbox(pop(s0)));
+	}
+
+	if (op == OP_MIN || op == OP_MAX) {
+		x = pop(s0);
+
+		while (!isempty(s0)) {
+			y = pop(s0);
+
+			if (compare(unbox(y), unbox(x)) == (op == OP_MIN ? -1 : 1)) {
+				x = y;
+			}
+		}
+
+		push(s0, x);
+		return;
+	}
+
+	for (j = 0; j < count(s0); j++) {
+		t.items[j] = value(unbox(s0->items[j]));
+	}
+
+	t.top = count(s0);
+	clear(s0);
+	push(s0, box(approx(op == OP_PERCENTILE ? percentile(&t, p) : statistic(&t, op))));
+}
+
+/* Sort by insertion, comparing the numbers exactly. Unordered numbers
+ * stay where they are. */
+static void order(int reverse) {
+	int i, j, n = count(s0);
+	double x;
+
+	for (i = 1; i < n; i++) {
+		x = s0->items[i];
+
+		for (j = i; j > 0; j--) {
+			if (compare(unbox(s0->items[j-1]), unbox(x)) != (reverse ? -1 : 1)) {
+				break;
+			}
+
+			s0->items[j] = s0->items[j-1];
+		}
+
+		s0->items[j] = x;
+	}
+}
+
+/* Matrices work on doubles, and only the numbers they use are
+ * converted back. */
+static void tabulate(int op) {
+	int j, k, n = count(s0);
+	stack t;
+	double x;
+
+	for (j = 0; j < n; j++) {
+		t.items[j] = value(unbox(s0->items[j]));
+	}
+
+	t.top = n;
+	k = span(&t, op);
+
+	if (matrix(&t, op)) {
+		s0->top = n - k;
+
+		for (j = n - k; j < count(&t); j++) {
+			x = t.items[j];
+			push(s0, box(x == floor(x) ? rounded(x) : approx(x)));
+		}
+	}
+}
+
+/* Evaluate polynomials with the arithmetic of the mode, so they are
+ * exact if the numbers are. */
+static void horner(int each) {
+	double c[CAPACITY], a;
+	int j, k, m, n;
+	stack t;
+
+	for (j = 0; j < count(s0); j++) {
+		t.items[j] = value(unbox(s0->items[j]));
+	}
+
+	t.top = count(s0);
+
+	if ((n = degree(&t, each)) == 0) {
+		return;
+	}
+
+	pop(s0);
+	memcpy(c, s0->items + (count(s0) -= n), n * sizeof(double));
+	m = each ? count(s0) : 1;
+
+	for (j = count(s0) - m; j < count(s0); j++) {
+		for (a = c[0], k = 1; k < n; k++) {
+			a = box(binary(OP_MUL, unbox(a), unbox(s0->items[j])));
+			a = box(binary(OP_ADD, unbox(a), unbox(c[k])));
+		}
+
+		s0->items[j] = a;
+	}
+}
+
+/* Run an instruction that was compiled to OP_NUM. Conditions and
+ * counts for jumps are turned into plain doubles. */
+static void calc(inst *i) {
+	int op = i->arg;
+	double x, y;
+	num a, b;
+
+	switch (op) {
+	case OP_PUSH:
+		push(s0, i->value);
+		return;
+	case OP_JZ:
+	case OP_TIMES:
+		push(s0, value(unbox(pop(s0))));
+		return;
+	case OP_COUNT:
+		push(s0, box(integer(count(s0))));
+		return;
+	case OP_SUM:
+		total(OP_ADD, count(s0));
+		return;
+	case OP_PROD:
+		total(OP_MUL, count(s0));
+		return;
+	case OP_ADDN:
+		total(OP_ADD, value(unbox(pop(s0))));
+		return;
+	case OP_MULN:
+		total(OP_MUL, value(unbox(pop(s0))));
+		return;
+	case OP_MEAN:
+	case OP_VAR:
+	case OP_STDDEV:
+	case OP_MIN:
+	case OP_MAX:
+	case OP_MEDIAN:
+	case OP_PERCENTILE:
+		tally(op);
+		return;
+	case OP_SORT:
+	case OP_RSORT:
+		order(op == OP_RSORT);
+		return;
+	case OP_TRANSPOSE:
+	case OP_MMUL:
+	case OP_DET:
+	case OP_INV:
+	case OP_SOLVE:
+		tabulate(op);
+		return;
+	case OP_POLY:
+	case OP_POLYS:
+		horner(op == OP_POLYS);
+		return;
+	case OP_ROLL:
+		x = value(unbox(pop(s0)));
+		y = value(unbox(pop(s0)));
+		roll(s0, s1, y, x);
+		return;
+	case OP_STASH:
+		move(s0, s1, value(unbox(pop(s0))));
+		return;
+	case OP_FETCH:
+		move(s1, s0, value(unbox(pop(s0))));
+		return;
+	case OP_RANGE:
+		x = value(unbox(pop(s0)));
+		y = value(unbox(pop(s0)));
+		sequence(y, x < y ? -1 : 1, floor(fabs(x - y)) + 1);
+		return;
+	case OP_IOTA:
+		sequence(1, 1, floor(value(unbox(pop(s0)))));
+		return;
+	}
+
+	if (count(s0) < effects[op].in) {
+		return;
+	}
+
+	a = *unbox(pop(s0));
+
+	if (effects[op].in == 1) {
+		push(s0, box(unary(op, &a)));
+		return;
+	}
+
+	b = *unbox(pop(s0));
+	push(s0, box(binary(op, &b, &a)));
+}
+
+/* Word names and meanings live in a single string pool, and nodes
+ * refer to them by offset so the pool can grow without invalidating
+ * them. */
+#define name(N)    (pool + (N)->word)
+#define meaning(N) (pool + (N)->meaning)
+
+/* Every string in the pool has a bucket in an open addressing table,
+ * which also records the word it names, if any. Buckets are hashed
+ * ignoring case, so a word can be found however it's written. */
+typedef struct bucket {
+	size_t key;
+	int word;
+} bucket;
+
+static unsigned int hash(const char *str) {
+	unsigned int h = 2166136261u;
+
+	while (*str) {
+		h = (h ^ (unsigned char) tolower((unsigned char) *str++)) * 16777619u;
+	}
+
+	return h;
+}
+
+/* Find the bucket of a string, or of the word it names, or else the
+ * empty bucket where it would go. Keys are offsets in the pool plus one,
+ * so an empty bucket has a key of zero. */
+static bucket *find(const char *str, int word) {
+	unsigned int j = hash(str) & (maxbuckets - 1);
+	const char *s;
+
+	for (; table[j].key; j = (j + 1) & (maxbuckets - 1)) {
+		s = pool + table[j].key - 1;
+
+		if (word ? table[j].word >= 0 && !strcasecmp(str, s)
+				: !strcmp(str, s)) {
+			break;
+		}
+	}
+
+	return &table[j];
+}
+
+static node *get(const char *word) {
+	bucket *e;
+
+	if (nbuckets == 0) {
+		return NULL;
+	}
+
+	e = find(word, 1);
+
+	return e->key ? &words[e->word] : NULL;
+}
+
+/* Keep the table at most half full. */
+static void grow() {
+	bucket *old = table;
+	int j, n = maxbuckets;
+
+	maxbuckets = maxbuckets ? maxbuckets * 2 : 256;
+	table = (bucket *) calloc(maxbuckets, sizeof(bucket));
+
+	if (table == NULL) {
+		fprintf(stderr, "Not enough memory to load words\n");
+		exit(1);
+	}
+
+	for (j = 0; j < n; j++) {
+		if (old[j].key) {
+			*find(pool + old[j].key - 1, 0) = old[j];
+		}
+	}
+
+	free(old);
+}
+
+/* Return the offset of a string in the pool, adding it if it's not
+ * there yet, and record the word it names unless word is -1. */
+static size_t intern(const char *str, int word) {
+	bucket *e;
+
+	if (2 * (nbuckets + 1) > maxbuckets) {
+		grow();
+	}
+
+	e = find(str, 0);
+
+	if (e->key == 0) {
+		e->key = sdslen(pool) + 1;
+		e->word = -1;
+		pool = sdscatlen(pool, str, strlen(str) + 1);
+		nbuckets++;
+	}
+
+	if (word != -1) {
+		e->word = word;
+	}
+
+	return e->key - 1;
+}
+
+static void set(sds word, sds meaning) {
+	node *curr = get(word);
+
+	if (pool == NULL) {
+		pool = sdsempty();
+	}
+
+	if (curr != NULL) {
+		fprintf(stderr, "Duplicate definition of \"%s\"\n", word);
+		curr->meaning = intern(meaning, -1);
+		return;
+	}
+
+	if (nwords == maxwords) {
+		maxwords = maxwords ? maxwords * 2 : 64;
+		words = (node *) realloc(words, maxwords * sizeof(node));
+
+		if (words == NULL) {
+			fprintf(stderr, "Not enough memory to load words\n");
+			exit(1);
+		}
+	}
+
+	curr = &words[nwords];
+	curr->word = intern(word, nwords);
+	curr->meaning = intern(meaning, -1);
+	curr->state = PENDING;
+#ifdef JIT
+	curr->native = NULL;
+	curr->calls = 0;
+#endif
+	nwords++;
+}
+
+static void unload(node *w, int n);
+
+static void cleanup() {
+	unload(words, nwords);
+	free(words);
+	free(code);
+	sdsfree(pool);
+	free(table);
+
+	words = NULL;
+	code = NULL;
+	pool = NULL;
+	table = NULL;
+	nwords = 0;
+	maxwords = 0;
+	nbuckets = 0;
+	maxbuckets = 0;
+	ncode = 0;
+	maxcode = 0;
+}
+
+static int parse(sds input) {
+	int argc;
+	sds *argv = sdssplitargs(input, &argc);
+
+	if (argc == 0) {
+		sdsfreesplitres(argv, argc);
+		return 0;
+	}
+
+	if (argc != 2) {
+		sdsfreesplitres(argv, argc);
+		fprintf(stderr, "Incorrect definition: %s\n", input);
+		return 1;
+	}
+
+	set(argv[0], argv[1]);
+	sdsfreesplitres(argv, argc);
+
+	return 0;
+}
+
+static int load(sds filename) {
+	FILE *fp;
+
+	if ((fp = fopen(filename, "r")) == NULL) {
+		if (errno == ENOENT) {
+			return 0;
+		}
+
+		/* Remember the file anyway, to warn only once until it
+		 * changes again. */
+		stat(filename, &info);
+		fprintf(stderr, "Can't open file %s\n", filename);
+		return 1;
+	}
+
+	fstat(fileno(fp), &info);
+
+	char buf[BUFFER_MAX+1];
+	int linecount, i;
+
+	sds *lines;
+	sds content = sdsempty();
+
+	while(fgets(buf, BUFFER_MAX+1, fp) != NULL) {
+		content = sdscat(content, buf);
+	}
+
+	fclose(fp);
+
+	lines = sdssplitlen(content, strlen(content), "\n", 1, &linecount);
+
+	for (i = 0; i < linecount; i++) {
+		lines[i] = sdstrim(lines[i], " \t\r\n");
+
+		if (lines[i][0] == '#') {
+		  continue;
+		}
+
+		if (parse(lines[i]) != 0) {
+			sdsfreesplitres(lines, linecount);
+			sdsfree(content);
+
+			fprintf(stderr, "(%s:%d)\n", filename, i+1);
+			return 1;
+		}
+	}
+
+	sdsfreesplitres(lines, linecount);
+	sdsfree(content);
+
+	return 0;
+}
+
+/* Compilation */
+static void emit(inst i) {
+	if (ncode == maxcode) {
+		maxcode = maxcode ? maxcode * 2 : 256;
+		code = (inst *) realloc(code, maxcode * sizeof(inst));
+
+		if (code == NULL) {
+			fprintf(stderr, "Not enough memory to compile words\n");
+			exit(1);
+		}
+	}
+
+	code[ncode++] = i;
+}
+
+/* Registers hold values by name: `>x` pops a value into the register
+ * x and `x` pushes it back. Names are resolved to slots when the code
+ * is compiled, and every register used by the words or the input is
+ * declared before compiling, so it can be read before it's stored. */
+static sds regnames[REGS_MAX];
+static double regs[REGS_MAX];
+static int nregs = 0;
+
+static int lookup(const char *word) {
+	int i;
+
+	for (i = 0; i < (int) (sizeof(builtins) / sizeof(builtin)); i++) {
+		if (!strcasecmp(word, builtins[i].name)) {
+			return builtins[i].op;
+		}
+	}
+
+	return -1;
+}
+
+static int reg(const char *word) {
+	int i;
+
+	for (i = 0; i < nregs; i++) {
+		if (!strcasecmp(word, regnames[i])) {
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+static void declare(const char *input) {
+	int i, argc;
+	sds *argv = sdssplitargs(input, &argc);
+
+	for (i = 0; i < argc; i++) {
+		if (argv[i][0] != '>' || !isalpha(argv[i][1])) {
+			continue;
+		}
+
+		if (reg(argv[i] + 1) != -1) {
+			continue;
+		}
+
+		/* A word would shadow the register. */
+		if (lookup(argv[i] + 1) != -1 || get(argv[i] + 1) != NULL) {
+			continue;
+		}
+
+		if (nregs == REGS_MAX) {
+			fprintf(stderr, "Too many registers\n");
+			break;
+		}
+
+		regnames[nregs++] = sdsnew(argv[i] + 1);
+	}
+
+	sdsfreesplitres(argv, argc);
+}
+
+/* Operations that only move items around work on the numbers of any
+ * mode, and the rest go through calc. */
+static int numeric(int op) {
+	switch (op) {
+	case OP_HOLE: case OP_DUP: case OP_SWAP: case OP_DROP:
+	case OP_CLEAR: case OP_STASH1: case OP_FETCH1:
+	case OP_STASHALL: case OP_FETCHALL:
+		return 0;
+	}
+
+	return mode != MODE_DOUBLE;
+}
+
+/* Jumps take their conditions and counts as plain doubles. */
+static void condition(int op) {
+	inst in = {OP_NUM, op, 0};
+
+	if (mode != MODE_DOUBLE) {
+		emit(in);
+	}
+}
+
+static void compileword(node *n);
+
+#define isjump(OP) ((OP) >= OP_JUMP && (OP) <= OP_MAP)
+
+/* Apply the rewrites to the code from start to the end of the buffer.
+ * Instructions are copied one by one and the last two are checked
+ * after each copy, so a rewrite can enable the next one. Instructions
+ * that are the target of a jump are not merged with the previous one,
+ * and jumps are adjusted to the new positions afterwards. */
+static void peephole(int start) {
+	int i, j, n = 0, len = ncode - start;
+	int *map = (int *) malloc((len + 1) * sizeof(int));
+	char *target = (char *) calloc(len + 1, 1);
+	char *mark = (char *) calloc(len + 1, 1);
+	char pending = 0;
+	inst *c = &code[start];
+	inst *a, *b;
+
+	if (map == NULL || target == NULL || mark == NULL) {
+		fprintf(stderr, "Not enough memory to compile words\n");
+		exit(1);
+	}
+
+	for (i = 0; i < len; i++) {
+		if (isjump(c[i].op)) {
+			c[i].arg += i;
+			target[c[i].arg] = 1;
+		}
+	}
+
+	for (i = 0; i < len; i++) {
+		map[i] = n;
+		mark[n] = target[i] || pending;
+		pending = 0;
+		c[n++] = c[i];
+
+		for (j = 0; n > 1 && j < (int) (sizeof(rewrites) / sizeof(rewrite)); j++) {
+			a = &c[n-2];
+			b = &c[n-1];
+
+			if (mark[n-1] || a->op != rewrites[j].first || b->op != rewrites[j].second) {
+				continue;
+			}
+
+			if (rewrites[j].op == OP_END) {
+				pending = mark[n-2];
+				n -= 2;
+			} else {
+				a->op = rewrites[j].op;
+				n -= 1;
+			}
+
+			j = -1;
+		}
+	}
+
+	map[len] = n;
+
+	for (i = 0; i < n; i++) {
+		if (isjump(c[i].op)) {
+			c[i].arg = map[c[i].arg] - i;
+		}
+	}
+
+	ncode = start + n;
+
+	free(map);
+	free(target);
+	free(mark);
+}
+
+static int keyword(const char *word) {
+	int i;
+
+	for (i = 0; i < (int) (sizeof(keywords) / sizeof(char *)); i++) {
+		if (!strcasecmp(word, keywords[i])) {
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+/* Emit the jumps for a keyword. Blocks are kept in a stack with the
+ * kind of each block and the position of the instruction to patch
+ * when the block is closed. Returns 1 if the keyword doesn't match
+ * the open blocks. */
+static int block(int k, int *kinds, int *marks, int *nblocks) {
+	int top = *nblocks - 1;
+	int kind = top < 0 ? -1 : kinds[top];
+	inst in = {OP_JUMP, 0, 0};
+
+	switch (k) {
+	case KW_IF:
+	case KW_TIMES:
+	case KW_BEGIN:
+	case KW_MAP:
+		if (*nblocks == BLOCKS_MAX) {
+			return 1;
+		}
+
+		in.op = k == KW_IF ? OP_JZ : k == KW_TIMES ? OP_TIMES : OP_MAP;
+
+		if (k == KW_IF || k == KW_TIMES) {
+			condition(in.op);
+		}
+
+		kinds[*nblocks] = k;
+		marks[*nblocks] = ncode;
+		(*nblocks)++;
+
+		if (k != KW_BEGIN) {
+			emit(in);
+		}
+
+		return 0;
+	case KW_ELSE:
+		if (kind != KW_IF) {
+			return 1;
+		}
+
+		emit(in);
+		code[marks[top]].arg = ncode - marks[top];
+		kinds[top] = KW_ELSE;
+		marks[top] = ncode - 1;
+		return 0;
+	case KW_THEN:
+		if (kind != KW_IF && kind != KW_ELSE) {
+			return 1;
+		}
+
+		code[marks[top]].arg = ncode - marks[top];
+		(*nblocks)--;
+		return 0;
+	case KW_WHILE:
+		if (kind != KW_BEGIN || *nblocks == BLOCKS_MAX) {
+			return 1;
+		}
+
+		condition(OP_JZ);
+
+		kinds[*nblocks] = KW_WHILE;
+		marks[*nblocks] = ncode;
+		(*nblocks)++;
+
+		in.op = OP_JZ;
+		emit(in);
+		return 0;
+	case KW_END:
+		if (kind == KW_MAP) {
+			in.op = OP_END;
+			emit(in);
+			code[marks[top]].arg = ncode - marks[top];
+			(*nblocks)--;
+			return 0;
+		}
+
+		if (kind == KW_TIMES) {
+			in.op = OP_LOOP;
+			in.arg = marks[top] + 1 - ncode;
+			emit(in);
+			code[marks[top]].arg = ncode - marks[top];
+			(*nblocks)--;
+			return 0;
+		}
+
+		if (kind == KW_WHILE) {
+			code[marks[top]].arg = ncode + 1 - marks[top];
+			(*nblocks)--;
+			top--;
+		} else if (kind != KW_BEGIN) {
+			return 1;
+		}
+
+		in.arg = marks[top] - ncode;
+		emit(in);
+		(*nblocks)--;
+		return 0;
+	}
+
+	return 1;
+}
+
+/* Translate a sequence of tokens into instructions, with words
+ * referenced by index. Small words are copied into their callers. */
+static int compile(const char *input, node *caller) {
+	int i, j, k, op, argc, start;
+	int kinds[BLOCKS_MAX], marks[BLOCKS_MAX], nblocks = 0;
+	double a;
+	char *z;
+	node *n;
+	inst in;
+
+	sds *argv = sdssplitargs(input, &argc);
+
+	if (caller == NULL) {
+		declare(input);
+	}
+
+	if (caller != NULL) {
+		for (i = 0; i < argc; i++) {
+			if (lookup(argv[i]) == -1 && (n = get(argv[i])) != NULL) {
+				compileword(n);
+			}
+		}
+	}
+
+	start = ncode;
+
+	for (i = 0; i < argc; i++) {
+		in.op = OP_END;
+		in.arg = 0;
+		in.value = 0;
+
+		if ((k = keyword(argv[i])) != -1) {
+			if (block(k, kinds, marks, &nblocks) != 0 && caller != NULL) {
+				fprintf(stderr, "Unexpected \"%s\" in \"%s\"\n",
+					argv[i], name(caller));
+			}
+		} else if ((op = lookup(argv[i])) != -1) {
+			in.op = op;
+
+			if (numeric(op)) {
+				in.op = OP_NUM;
+				in.arg = op;
+			}
+
+			emit(in);
+		} else if (argv[i][0] == '>' && (k = reg(argv[i] + 1)) != -1) {
+			in.op = OP_SET;
+			in.arg = k;
+			emit(in);
+		} else if ((n = get(argv[i])) != NULL) {
+			if (n->state == DONE && n->size <= INLINE_MAX && !n->memo) {
+				for (j = 0; j < n->size; j++) {
+					emit(code[n->code + j]);
+				}
+			} else {
+				in.op = OP_CALL;
+				in.arg = n - words;
+				emit(in);
+			}
+		} else {
+			a = strtod(argv[i], &z);
+
+			if (*z == '\0') {
+				in.op = OP_PUSH;
+				in.value = a;
+
+				if (numeric(OP_PUSH)) {
+					in.op = OP_NUM;
+					in.arg = OP_PUSH;
+					in.value = box(number(argv[i]));
+				}
+
+				emit(in);
+				continue;
+			}
+
+			if ((k = reg(argv[i])) != -1) {
+				in.op = OP_GET;
+				in.arg = k;
+				emit(in);
+				continue;
+			}
+
+			if (caller != NULL) {
+				fprintf(stderr, "Undefined word \"%s\" in \"%s\"\n",
+					argv[i], name(caller));
+			}
+
+			if (!isalpha(argv[i][0])) {
+				in.op = OP_PUSH;
+				in.value = NAN;
+
+				if (numeric(OP_PUSH)) {
+					in.op = OP_NUM;
+					in.arg = OP_PUSH;
+					in.value = box(inexact(NAN));
+				}
+
+				emit(in);
+			}
+		}
+	}
+
+	if (nblocks > 0 && caller != NULL) {
+		fprintf(stderr, "Unterminated block in \"%s\"\n", name(caller));
+	}
+
+	while (nblocks > 0) {
+		k = kinds[nblocks - 1];
+		block(k == KW_IF || k == KW_ELSE ? KW_THEN : KW_END,
+			kinds, marks, &nblocks);
+	}
+
+	if (optimize) {
+		peephole(start);
+	}
+
+	in.op = OP_END;
+	emit(in);
+
+	sdsfreesplitres(argv, argc);
+
+	return start;
+}
+
+static void run(int ip, int fast);
+static void compact();
+
+/* Compute the stack effect of a word: the number of items it needs,
+ * the number it leaves and the height the stack reaches, counting its
+ * inputs. It's only known if every instruction is pure, and if every
+ * path to an instruction reaches it with the same depth. Words that
+ * loop and have a known effect remember their results. */
+static void measure(node *n) {
+	int i, k, in, out, peak, d = 0, low = 0, high = 0, loops = 0;
+	int *depth = (int *) malloc((n->size + 1) * sizeof(int));
+	char *known = (char *) calloc(n->size + 1, 1);
+	char reached = 1;
+	node *w;
+	inst *c;
+
+	if (depth == NULL || known == NULL) {
+		fprintf(stderr, "Not enough memory to compile words\n");
+		exit(1);
+	}
+
+	n->pure = 0;
+	n->loops = 0;
+	n->memo = 0;
+
+	for (i = 0; i <= n->size; i++) {
+		if (known[i]) {
+			if (reached && depth[i] != d) {
+				goto done;
+			}
+
+			d = depth[i];
+		} else if (!reached) {
+			goto done;
+		}
+
+		known[i] = 1;
+		depth[i] = d;
+		reached = 1;
+
+		if (i == n->size) {
+			break;
+		}
+
+		c = &code[n->code + i];
+
+		if (c->op == OP_MAP) {
+			goto done;
+		} else if (c->op == OP_CALL) {
+			w = &words[c->arg];
+
+			if (w == n || w->state != DONE || !w->pure) {
+				goto done;
+			}
+
+			in = w->in;
+			out = w->out;
+			peak = w->height;
+			loops |= w->loops;
+		} else if (c->op == OP_JZ || c->op == OP_TIMES) {
+			in = 1;
+			out = 0;
+			peak = 1;
+		} else if (isjump(c->op)) {
+			in = out = peak = 0;
+		} else if (effects[c->op].pure) {
+			in = effects[c->op].in;
+			out = effects[c->op].out;
+			peak = in > out ? in : out;
+		} else {
+			goto done;
+		}
+
+		if (d - in < low) {
+			low = d - in;
+		}
+
+		if (d - in + peak > high) {
+			high = d - in + peak;
+		}
+
+		d += out - in;
+
+		if (isjump(c->op)) {
+			k = i + c->arg;
+
+			if (k <= i) {
+				loops = 1;
+			}
+
+			if (known[k] && depth[k] != d) {
+				goto done;
+			}
+
+			if (!known[k] && k <= i) {
+				goto done;
+			}
+
+			known[k] = 1;
+			depth[k] = d;
+			reached = c->op != OP_JUMP;
+		}
+	}
+
+	n->pure = 1;
+	n->loops = loops;
+	n->in = -low;
+	n->out = d - low;
+	n->height = high - low;
+	n->memo = loops && n->in + n->out <= MEMO_VALUES;
+
+done:
+	free(depth);
+	free(known);
+}
+
+/* A word that takes no inputs and has no side effects can be replaced
+ * by the values it leaves. */
+static void fold(node *n) {
+	stack *s = s0;
+	stack t;
+	inst in;
+	int i;
+
+	if (!n->pure || n->loops || n->in > 0 || n->height >= CAPACITY) {
+		return;
+	}
+
+	s0 = &t;
+	clear(s0);
+	run(n->code, 1);
+	s0 = s;
+
+	/* The word is the last one compiled, so its code can be replaced
+	 * even if the values take more room. */
+	ncode = n->code;
+	in.arg = 0;
+
+	for (i = 0; i < count(&t); i++) {
+		in.op = OP_PUSH;
+		in.value = t.items[i];
+		emit(in);
+	}
+
+	in.op = OP_END;
+	in.value = 0;
+	emit(in);
+
+	n->size = i;
+	n->height = i;
+}
+
+static void compileword(node *n) {
+	if (n->state == DONE) {
+		return;
+	}
+
+	if (n->state == COMPILING) {
+		fprintf(stderr, "Recursive definition of \"%s\"\n", name(n));
+		return;
+	}
+
+	n->state = COMPILING;
+	n->code = compile(meaning(n), n);
+	n->size = ncode - n->code - 1;
+	n->state = DONE;
+
+	measure(n);
+	fold(n);
+}
+
+/* Compile the definitions in dependency order, checking for cycles
+ * and references to undefined words. */
+static void build() {
+	int i;
+
+	for (i = 0; i < nwords; i++) {
+		declare(meaning(&words[i]));
+	}
+
+	for (i = 0; i < nwords; i++) {
+		compileword(&words[i]);
+	}
+}
+
+#ifdef JIT
+/* Native code
+ *
+ * Hot words with a known stack effect are translated to SSE2 code.
+ * Each stack slot used by the word is mapped to a register, from xmm0
+ * to xmm14, and xmm15 is kept for temporary values. The generated
+ * function receives a pointer to the first input in rdi, loads the
+ * inputs, and stores the results in their place. */
+static unsigned char jitbuf[JIT_MAX];
+static int jitlen;
+
+static void byte(int b) {
+	if (jitlen < JIT_MAX) {
+		jitbuf[jitlen] = b;
+	}
+
+	jitlen++;
+}
+
+static void rex(int w, int reg, int rm) {
+	if (w || reg > 7 || rm > 7) {
+		byte(0x40 | (w << 3) | ((reg > 7) << 2) | (rm > 7));
+	}
+}
+
+/* Register to register operation, e.g. addsd reg, rm. */
+static void sse(int prefix, int opcode, int reg, int rm) {
+	byte(prefix);
+	rex(0, reg, rm);
+	byte(0x0F);
+	byte(opcode);
+	byte(0xC0 | (reg & 7) << 3 | (rm & 7));
+}
+
+/* Load or store the slot at offset disp from rdi. */
+static void slot(int opcode, int reg, int disp) {
+	byte(0xF2);
+	rex(0, reg, 0);
+	byte(0x0F);
+	byte(opcode);
+	byte(0x80 | (reg & 7) << 3 | 7);
+	byte(disp);
+	byte(disp >> 8);
+	byte(disp >> 16);
+	byte(disp >> 24);
+}
+
+/* Load a constant with mov rax, imm64 and movq reg, rax. */
+static void konst(int reg, double value) {
+	unsigned char bits[8];
+	int i;
+
+	memcpy(bits, &value, 8);
+
+	byte(0x48);
+	byte(0xB8);
+
+	for (i = 0; i < 8; i++) {
+		byte(bits[i]);
+	}
+
+	byte(0x66);
+	rex(1, reg, 0);
+	byte(0x0F);
+	byte(0x6E);
+	byte(0xC0 | (reg & 7) << 3);
+}
+
+static void *jit(node *n) {
+	int i, d = n->in;
+	double mask;
+	inst *c;
+	void *p;
+
+	if (!n->pure || n->height > JIT_SLOTS) {
+		return NULL;
+	}
+
+	jitlen = 0;
+
+	for (i = 0; i < n->in; i++) {
+		slot(0x10, i, i * 8);
+	}
+
+	for (c = &code[n->code]; c->op != OP_END; c++) {
+		switch (c->op) {
+		case OP_PUSH:
+			konst(d++, c->value);
+			break;
+		case OP_ADD:
+			d--;
+			sse(0xF2, 0x58, d - 1, d);
+			break;
+		case OP_SUB:
+			d--;
+			sse(0xF2, 0x5C, d - 1, d);
+			break;
+		case OP_MUL:
+			d--;
+			sse(0xF2, 0x59, d - 1, d);
+			break;
+		case OP_DIV:
+			d--;
+			sse(0xF2, 0x5E, d - 1, d);
+			break;
+		case OP_ADDK:
+			konst(15, c->value);
+			sse(0xF2, 0x58, d - 1, 15);
+			break;
+		case OP_SUBK:
+			konst(15, c->value);
+			sse(0xF2, 0x5C, d - 1, 15);
+			break;
+		case OP_MULK:
+			konst(15, c->value);
+			sse(0xF2, 0x59, d - 1, 15);
+			break;
+		case OP_DIVK:
+			konst(15, c->value);
+			sse(0xF2, 0x5E, d - 1, 15);
+			break;
+		case OP_POWK:
+			if (c->value != 2) {
+				return NULL;
+			}
+
+			sse(0xF2, 0x59, d - 1, d - 1);
+			break;
+		case OP_SQUARE:
+			sse(0xF2, 0x59, d - 1, d - 1);
+			break;
+		case OP_ABS:
+			memset(&mask, 0xFF, sizeof(mask));
+			mask = fabs(mask);
+			konst(15, mask);
+			sse(0x66, 0x54, d - 1, 15);
+			break;
+		case OP_DUP:
+			sse(0x66, 0x28, d, d - 1);
+			d++;
+			break;
+		case OP_SWAP:
+			sse(0x66, 0x28, 15, d - 1);
+			sse(0x66, 0x28, d - 1, d - 2);
+			sse(0x66, 0x28, d - 2, 15);
+			break;
+		case OP_DROP:
+			d--;
+			break;
+		case OP_NIP:
+			sse(0x66, 0x28, d - 2, d - 1);
+			d--;
+			break;
+		default:
+			return NULL;
+		}
+	}
+
+	for (i = 0; i < n->out; i++) {
+		slot(0x11, i, i * 8);
+	}
+
+	byte(0xC3);
+
+	if (jitlen > JIT_MAX) {
+		return NULL;
+	}
+
+	p = mmap(NULL, jitlen, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+	if (p == MAP_FAILED) {
+		return NULL;
+	}
+
+	memcpy(p, jitbuf, jitlen);
+
+	if (mprotect(p, jitlen, PROT_READ | PROT_EXEC) != 0) {
+		munmap(p, jitlen);
+		return NULL;
+	}
+
+	n->length = jitlen;
+
+	return p;
+}
+#endif
+
+/* Release the native code of the words in a dictionary. */
+static void unload(node *w, int n) {
+#ifdef JIT
+	int i;
+
+	for (i = 0; i < n; i++) {
+		if (w[i].native != NULL) {
+			munmap(w[i].native, w[i].length);
+		}
+	}
+#endif
+}
+
+/* Vectors
+ *
+ * The body of a map runs once for each item in the stack. When it
+ * only does arithmetic and leaves one value in place of each item,
+ * the items are instead loaded in a column and each instruction is
+ * applied to the whole column at once, VEC_LANES values at a time.
+ * Literals, registers and the hole are broadcast to every lane. */
+#ifdef __GNUC__
+#define SIMD
+#endif
+
+#ifdef SIMD
+typedef double vec __attribute__ ((vector_size (VEC_LANES * sizeof(double))));
+
+static vec cols[VEC_SLOTS][VEC_CHUNK];
+
+/* Polynomial kernels for sin, cos, tan, ln and log, with coefficients
+ * from fdlibm. The trigonometric functions reduce their argument to
+ * [-pi/4, pi/4] with pi/2 split in three parts, and the logarithms
+ * split their argument in a power of two and a mantissa near 1.
+ * Measured against a long double reference, sin, cos, ln and log are
+ * within 1 ulp, and tan within 2.5 ulp. Lanes where the reduction
+ * loses bits, or that are out of the domain of the kernels, are
+ * computed with libm, and libm is used for every lane if $CLAC_LIBM
+ * is set. */
+typedef unsigned long long mask __attribute__ ((vector_size (VEC_LANES * sizeof(double))));
+
+#define SELECT(M, A, B) ((vec) (((mask) (A) & (M)) | ((mask) (B) & ~(M))))
+#define SIGN(M)         ((mask) (M) << 63)
+#define ROUNDER         6755399441055744.0
+
+#define TRIG_MAX 1e5
+#define TRIG_MIN 3.7252902984e-09
+
+#define PIO2_1   1.57079632673412561417e+00
+#define PIO2_2   6.07710050630396597660e-11
+#define PIO2_3   2.02226624871116645580e-21
+#define INVPIO2  6.36619772367581382433e-01
+
+#define S1 -1.66666666666666324348e-01
+#define S2  8.33333333332248946124e-03
+#define S3 -1.98412698298579493134e-04
+#define S4  2.75573137070700676789e-06
+#define S5 -2.50507602534068634195e-08
+#define S6  1.58969099521155010221e-10
+
+#define C1  4.16666666666666019037e-02
+#define C2 -1.38888888888741095749e-03
+#define C3  2.48015872894767294178e-05
+#define C4 -2.75573143513906633035e-07
+#define C5  2.08757232129817482790e-09
+#define C6 -1.13596475577881948265e-11
+
+#define LG1 6.666666666666735130e-01
+#define LG2 3.999999999940941908e-01
+#define LG3 2.857142874366239149e-01
+#define LG4 2.222219843214978396e-01
+#define LG5 1.818357216161805012e-01
+#define LG6 1.531383769920937332e-01
+#define LG7 1.479819860511658591e-01
+
+#define LN2_HI     6.93147180369123816490e-01
+#define LN2_LO     1.90821492927058770002e-10
+#define LOG2_HI    3.01029995663611771306e-01
+#define LOG2_LO    3.69423907715893078616e-13
+#define INVLN10_HI 4.34294481878168880939e-01
+#define INVLN10_LO 2.50829467116452752298e-11
+#define SQRT2      1.41421356237309504880e+00
+
+#define INLINE inline __attribute__ ((always_inline))
+
+/* On x86-64 Linux the kernels are also compiled for AVX2, and the
+ * version to use is picked when the program starts. They are compiled
+ * for speed, as -Os leaves out the vzeroupper that AVX code needs
+ * before returning to SSE code. */
+#if defined(__x86_64__) && defined(__linux__)
+#define CLONES __attribute__ ((target_clones ("avx2", "default"), optimize ("O2")))
+#else
+#define CLONES
+#endif
+
+static vec spare[VEC_CHUNK];
+static mask flags[VEC_CHUNK];
+
+/* Reduce x to r + y in [-pi/4, pi/4], where y is the tail of r, with
+ * x = r + y + n pi/2 and q = n mod 4, and compute the sine and cosine
+ * of r + y. Lanes where the reduction isn't exact, and zeros, which
+ * would lose their sign, are set in bad. */
+static INLINE void reduce(vec *x, vec *s, vec *c, mask *q, mask *bad) {
+	vec n = *x * INVPIO2 + ROUNDER;
+	vec r, t, w, y, z, v, p;
+
+	*q = (mask) n & 3;
+	n = n - ROUNDER;
+	t = *x - n * PIO2_1;
+	w = n * PIO2_2;
+	r = t - w;
+	y = ((t - r) - w) - n * PIO2_3;
+	t = r + y;
+	y = (r - t) + y;
+	r = t;
+
+	*bad = (mask) (r != *x) & (mask) (r * r < TRIG_MIN * TRIG_MIN);
+	*bad |= ~(mask) (*x * *x <= TRIG_MAX * TRIG_MAX) | (mask) (*x == 0);
+
+	z = r * r;
+	v = z * r;
+	p = S2 + z * (S3 + z * (S4 + z * (S5 + z * S6)));
+	*s = r - ((z * (0.5 * y - v * p) - y) - v * S1);
+
+	w = z * z;
+	p = z * (C1 + z * (C2 + z * C3)) + w * w * (C4 + z * (C5 + z * C6));
+	v = 0.5 * z;
+	w = 1 - v;
+	*c = w + (((1 - w) - v) + (z * p - r * y));
+}
+
+/* Recompute the lanes flagged by a kernel with libm, taking the
+ * arguments from the spare column. */
+static void fallback(vec *a, int m, mask *any, double (*f)(double)) {
+	int k, l;
+
+	for (l = 0; l < VEC_LANES && !(*any)[l]; l++);
+
+	if (l == VEC_LANES) {
+		return;
+	}
+
+	for (k = 0; k < m; k++) {
+		for (l = 0; l < VEC_LANES; l++) {
+			if (flags[k][l]) {
+				a[k][l] = f(spare[k][l]);
+			}
+		}
+	}
+}
+
+CLONES static void vsin(vec *a, int m) {
+	vec s, c;
+	mask q, any = {0};
+	int k;
+
+	memcpy(spare, a, m * sizeof(vec));
+
+	for (k = 0; k < m; k++) {
+		reduce(&a[k], &s, &c, &q, &flags[k]);
+		s = SELECT(-(q & 1), c, s);
+		a[k] = (vec) ((mask) s ^ SIGN(q >> 1));
+		any |= flags[k];
+	}
+
+	fallback(a, m, &any, sin);
+}
+
+CLONES static void vcos(vec *a, int m) {
+	vec s, c;
+	mask q, any = {0};
+	int k;
+
+	memcpy(spare, a, m * sizeof(vec));
+
+	for (k = 0; k < m; k++) {
+		reduce(&a[k], &s, &c, &q, &flags[k]);
+		c = SELECT(-(q & 1), s, c);
+		a[k] = (vec) ((mask) c ^ SIGN(((q + 1) >> 1) & 1));
+		any |= flags[k];
+	}
+
+	fallback(a, m, &any, cos);
+}
+
+CLONES static void vtan(vec *a, int m) {
+	vec s, c;
+	mask q, odd, any = {0};
+	int k;
+
+	memcpy(spare, a, m * sizeof(vec));
+
+	for (k = 0; k < m; k++) {
+		reduce(&a[k], &s, &c, &q, &flags[k]);
+		odd = -(q & 1);
+		a[k] = SELECT(odd, -c, s) / SELECT(odd, s, c);
+		any |= flags[k];
+	}
+
+	fallback(a, m, &any, tan);
+}
+
+/* Split x in 2^k times 1 + f, with 1 + f in [sqrt(2)/2, sqrt(2)], so
+ * that ln(1 + f) = f - h + r. Zero, negative, subnormal and non-finite
+ * lanes are set in bad. */
+static INLINE void split(vec *x, vec *k, vec *f, vec *h, vec *r, mask *bad) {
+	mask bits = (mask) *x;
+	mask e = ((bits >> 52) & 0x7ff) - 1023;
+	vec m = (vec) ((bits & 0x000fffffffffffffLL) | 0x3ff0000000000000LL);
+	mask big = (mask) (m > SQRT2);
+	vec s, z, w;
+
+	*bad = ~((mask) (*x >= DBL_MIN) & (mask) (*x <= DBL_MAX));
+
+	m = SELECT(big, m * 0.5, m);
+	e = e - big;
+	*k = (vec) (e + 0x4338000000000000LL) - ROUNDER;
+
+	*f = m - 1;
+	*h = 0.5 * *f * *f;
+	s = *f / (2 + *f);
+	z = s * s;
+	w = z * z;
+	z = z * (LG1 + w * (LG3 + w * (LG5 + w * LG7))) + w * (LG2 + w * (LG4 + w * LG6));
+	*r = s * (*h + z);
+}
+
+CLONES static void vlog(vec *a, int m) {
+	vec e, f, h, r;
+	mask any = {0};
+	int k;
+
+	memcpy(spare, a, m * sizeof(vec));
+
+	for (k = 0; k < m; k++) {
+		split(&a[k], &e, &f, &h, &r, &flags[k]);
+		a[k] = e * LN2_HI - ((h - (r + e * LN2_LO)) - f);
+		any |= flags[k];
+	}
+
+	fallback(a, m, &any, log);
+}
+
+/* The result is built from the high and low parts of ln(1 + f) and
+ * of the constants, so the multiplications don't add their errors. */
+CLONES static void vlog10(vec *a, int m) {
+	vec e, f, h, r, hi, lo, y, w;
+	mask any = {0};
+	int k;
+
+	memcpy(spare, a, m * sizeof(vec));
+
+	for (k = 0; k < m; k++) {
+		split(&a[k], &e, &f, &h, &r, &flags[k]);
+		hi = f - h;
+		hi = (vec) ((mask) hi & 0xffffffff00000000ULL);
+		lo = (f - hi) - h + r;
+
+		y = e * LOG2_HI;
+		w = y + hi * INVLN10_HI;
+		lo = e * LOG2_LO + (lo + hi) * INVLN10_LO + lo * INVLN10_HI;
+		a[k] = w + (lo + ((y - w) + hi * INVLN10_HI));
+		any |= flags[k];
+	}
+
+	fallback(a, m, &any, log10);
+}
+
+#define EACH(E)  for (k = 0; k < m; k++) { E; }
+#define LANES(E) for (k = 0; k < m; k++) for (l = 0; l < VEC_LANES; l++) { E; }
+#define UNARY(F) LANES(a[k][l] = F(a[k][l]))
+#define KERNEL(F, G) if (exact) { UNARY(G); } else { F(a, m); }
+#define BINOP(E) LANES(b[k][l] = E)
+
+/* Run a body on the first m vectors of the columns. */
+static void vector(inst *i, int m) {
+	vec *a, *b, *c, x;
+	double y;
+	int d = 1, k, l;
+
+	for (; i->op != OP_END; i++) {
+		a = cols[d - 1];
+		b = d > 1 ? cols[d - 2] : NULL;
+		c = cols[d];
+
+		switch (i->op) {
+		case OP_PUSH:
+		case OP_HOLE:
+		case OP_GET:
+			y = i->op == OP_PUSH ? i->value : i->op == OP_HOLE ? hole : regs[i->arg];
+			x = (vec) {0} + y;
+			EACH(c[k] = x);
+			d++;
+			break;
+		case OP_ADD: EACH(b[k] = b[k] + a[k]); d--; break;
+		case OP_SUB: EACH(b[k] = b[k] - a[k]); d--; break;
+		case OP_MUL: EACH(b[k] = b[k] * a[k]); d--; break;
+		case OP_DIV: EACH(b[k] = b[k] / a[k]); d--; break;
+		case OP_MOD: BINOP(modulo(b[k][l], a[k][l])); d--; break;
+		case OP_POW: BINOP(pow(b[k][l], a[k][l])); d--; break;
+		case OP_OR: BINOP((int)fabs(b[k][l])|(int)fabs(a[k][l])); d--; break;
+		case OP_AND: BINOP((int)fabs(b[k][l])&(int)fabs(a[k][l])); d--; break;
+		case OP_XOR: BINOP((int)fabs(b[k][l])^(int)fabs(a[k][l])); d--; break;
+		case OP_ATAN2: BINOP(atan2(b[k][l], a[k][l])); d--; break;
+		case OP_LT: BINOP(b[k][l] < a[k][l]); d--; break;
+		case OP_GT: BINOP(b[k][l] > a[k][l]); d--; break;
+		case OP_LE: BINOP(b[k][l] <= a[k][l]); d--; break;
+		case OP_GE: BINOP(b[k][l] >= a[k][l]); d--; break;
+		case OP_EQ: BINOP(b[k][l] == a[k][l]); d--; break;
+		case OP_NE: BINOP(b[k][l] != a[k][l]); d--; break;
+		case OP_NIP: EACH(b[k] = a[k]); d--; break;
+		case OP_DROP: d--; break;
+		case OP_DUP: EACH(c[k] = a[k]); d++; break;
+		case OP_SWAP: EACH(x = a[k]; a[k] = b[k]; b[k] = x); break;
+		case OP_ABS: UNARY(fabs); break;
+		case OP_CEIL: UNARY(ceil); break;
+		case OP_FLOOR: UNARY(floor); break;
+		case OP_ROUND: UNARY(round); break;
+		case OP_SIN: KERNEL(vsin, sin); break;
+		case OP_COS: KERNEL(vcos, cos); break;
+		case OP_TAN: KERNEL(vtan, tan); break;
+		case OP_ASIN: UNARY(asin); break;
+		case OP_ACOS: UNARY(acos); break;
+		case OP_ATAN: UNARY(atan); break;
+		case OP_LN: KERNEL(vlog, log); break;
+		case OP_LOG: KERNEL(vlog10, log10); break;
+		case OP_ERF: UNARY(erf); break;
+		case OP_FACT: UNARY(factorial); break;
+		case OP_CHOOSE: BINOP(choose(b[k][l], a[k][l])); d--; break;
+		case OP_LGAMMA: UNARY(lgamma); break;
+		case OP_SQUARE: EACH(a[k] = a[k] * a[k]); break;
+		case OP_ADDK: EACH(a[k] = a[k] + i->value); break;
+		case OP_SUBK: EACH(a[k] = a[k] - i->value); break;
+		case OP_MULK: EACH(a[k] = a[k] * i->value); break;
+		case OP_DIVK: EACH(a[k] = a[k] / i->value); break;
+		case OP_POWK:
+			if (i->value == 2) {
+				EACH(a[k] = a[k] * a[k]);
+			} else {
+				LANES(a[k][l] = pow(a[k][l], i->value));
+			}
+			break;
+		}
+	}
+}
+#endif
+
+/* Check that a body can run on columns. */
+static int vectorizable(inst *i) {
+	int d = 1;
+
+	for (; i->op != OP_END; i++) {
+		switch (i->op) {
+		case OP_PUSH: case OP_HOLE: case OP_GET:
+			d++;
+			break;
+		case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV:
+		case OP_MOD: case OP_POW: case OP_OR: case OP_AND:
+		case OP_XOR: case OP_ATAN2: case OP_CHOOSE: case OP_NIP: case OP_DROP:
+		case OP_LT: case OP_GT: case OP_LE: case OP_GE:
+		case OP_EQ: case OP_NE:
+			d--;
+			break;
+		case OP_DUP:
+			d++;
+			break;
+		case OP_SWAP:
+		case OP_ABS: case OP_CEIL: case OP_FLOOR: case OP_ROUND:
+		case OP_SIN: case OP_COS: case OP_TAN: case OP_ASIN:
+		case OP_ACOS: case OP_ATAN: case OP_LN: case OP_LOG:
+		case OP_ERF: case OP_FACT: case OP_LGAMMA: case OP_SQUARE:
+		case OP_ADDK: case OP_SUBK: case OP_MULK: case OP_DIVK:
+		case OP_POWK:
+			break;
+		default:
+			return 0;
+		}
+
+		if (d < effects[i->op].out || d > VEC_SLOTS) {
+			return 0;
+		}
+	}
+
+	return d == 1;
+}
+
+/* Apply the body of a map to each item in the stack. */
+static void map(inst *body) {
+	stack *s = s0;
+	stack t, r;
+	root a, b;
+	int j, k, n = count(s);
+
+#ifdef SIMD
+	if (optimize && vectorizable(body)) {
+		double *x = (double *) cols[0];
+		int size = VEC_CHUNK * VEC_LANES;
+
+		for (j = 0; j < n; j += size) {
+			k = n - j < size ? n - j : size;
+			memset(x, 0, sizeof(cols[0]));
+			memcpy(x, s->items + j, k * sizeof(double));
+			vector(body, (k + VEC_LANES - 1) / VEC_LANES);
+			memcpy(s->items + j, x, k * sizeof(double));
+		}
+
+		return;
+	}
+#endif
+
+	clear(&r);
+
+	a.s = s; a.next = roots;
+	b.s = &r; b.next = &a;
+	roots = &b;
+
+	for (j = 0; j < n; j++) {
+		clear(&t);
+		push(&t, s->items[j]);
+
+		s0 = &t;
+		run(body - code, 0);
+		s0 = s;
+
+		for (k = 0; k < count(&t); k++) {
+			push(&r, t.items[k]);
+		}
+	}
+
+	roots = a.next;
+	*s = r;
+}
+
+/* Add or multiply the items of a stack into a total, from the top down
+ * like sum and prod do. */
+static double accumulate(stack *s, int op, double acc, int *first) {
+	int j;
+
+	for (j = count(s) - 1; j >= 0; j--) {
+		if (*first) {
+			acc = s->items[j];
+			*first = 0;
+		} else if (op == OP_SUM) {
+			acc += s->items[j];
+		} else {
+			acc *= s->items[j];
+		}
+	}
+
+	return acc;
+}
+
+/* The reductions a sequence can stream into. */
+static int streams(int op) {
+	switch (op) {
+	case OP_SUM: case OP_PROD: case OP_MEAN: case OP_VAR:
+	case OP_STDDEV: case OP_MIN: case OP_MAX:
+		return 1;
+	}
+
+	return 0;
+}
+
+/* Push n numbers starting at a, or stream them into the sum, product
+ * or statistic that follows, with a map in between if its body leaves
+ * one value for each item. Streamed numbers go in chunks from the last
+ * one down, so a total is the same as if they had been pushed, and
+ * there's no limit on how many there are. Returns the last instruction
+ * used, or NULL if there were too many iterations. */
+static inst *series(inst *i, double a, double step, double n) {
+	stack *s = s0;
+	stack t;
+	inst *body = NULL, *r = i + 1;
+	summary z = {0};
+	double acc = 0;
+	int j, k, first = 1, sums;
+
+	if (r->op == OP_MAP) {
+		body = r + 1;
+		r += r->arg;
+	}
+
+	sums = r->op == OP_SUM || r->op == OP_PROD;
+
+	if (!(n >= 1) || !streams(r->op) ||
+			(body != NULL && !vectorizable(body))) {
+		for (j = 0; j < n && !isoverflow(s); j++) {
+			push(s, a + j * step);
+		}
+
+		return i;
+	}
+
+	if (limit) {
+		if (n >= limit) {
+			fprintf(stderr, "\r\nToo many iterations!\n");
+			return NULL;
+		}
+
+		limit -= n;
+	}
+
+	while (n > 0) {
+		k = n < CAPACITY ? n : CAPACITY;
+		n -= k;
+
+		for (j = 0; j < k; j++) {
+			t.items[j] = a + (n + j) * step;
+		}
+
+		t.top = k;
+
+		if (body != NULL) {
+			s0 = &t;
+			map(body);
+			s0 = s;
+		}
+
+		if (sums) {
+			acc = accumulate(&t, r->op, acc, &first);
+		} else {
+			gather(&z, &t);
+		}
+	}
+
+	if (body != NULL) {
+		map(body);
+	}
+
+	if (sums) {
+		acc = accumulate(s, r->op, acc, &first);
+	} else {
+		gather(&z, s);
+	}
+
+	clear(s);
+	push(s, sums ? acc : conclude(&z, r->op));
+
+	return r;
+}
+
+/* Execution
+ *
+ * The interpreter jumps from one instruction to the next through a
+ * table of labels when the compiler supports it, and goes through a
+ * switch otherwise. The top of the stack is kept in a local variable,
+ * and is written back to the stack before any operation that needs
+ * the whole stack in memory. */
+#ifdef __GNUC__
+#define THREADED
+#endif
+
+#ifdef THREADED
+#define CASE(OP) L_##OP
+#define FAST(OP) F_##OP:
+#define NEXT     goto *labels[(++i)->op]
+#define DISPATCH goto *labels[i->op]
+#else
+#define CASE(OP) case OP
+#define FAST(OP)
+#define NEXT     goto next
+#define DISPATCH goto dispatch
+#endif
+
+#define SAVE() do {                                                   \
+	if (sp > base) sp[-1] = t;                                    \
+	s0->top = sp - base;                                          \
+} while (0)
+
+#define LOAD() do {                                                   \
+	base = s0->items;                                             \
+	sp = base + s0->top;                                          \
+	if (sp > base) t = sp[-1];                                    \
+} while (0)
+
+#define NEED(N) if (sp - base < (N)) NEXT
+
+#define ROOM(N) if (sp - base + (N) > CAPACITY) {                     \
+	fprintf(stderr, "\r\nStack is full!\n");                      \
+	NEXT;                                                         \
+}
+
+#define RAWPUSH(X) do {                                               \
+	a = (X);                                                      \
+	if (sp > base) sp[-1] = t;                                    \
+	t = a;                                                        \
+	sp++;                                                         \
+} while (0)
+
+#define PUSH(X) do {                                                  \
+	if (sp - base == CAPACITY) {                                  \
+		fprintf(stderr, "\r\nStack is full!\n");              \
+	} else {                                                      \
+		RAWPUSH(X);                                           \
+	}                                                             \
+} while (0)
+
+#define BINARY(E) do {                                                \
+	a = t;                                                        \
+	b = sp[-2];                                                   \
+	sp--;                                                         \
+	t = (E);                                                      \
+} while (0)
+
+/* A fused push on a full stack fails like the push it replaces, and
+ * the operation after it takes the two items below instead. */
+#define FULL(E) if (sp - base == CAPACITY) {                          \
+	fprintf(stderr, "\r\nStack is full!\n");                      \
+	BINARY(E);                                                    \
+	NEXT;                                                         \
+}
+
+/* Check if a stack with c items has the ones a word needs and room for
+ * the ones it pushes, so it can run without checking each instruction. */
+static int fits(node *n, int c) {
+	return n->pure && c >= n->in && c - n->in + n->height <= CAPACITY;
+}
+
+/* Results of words that loop are kept in a set-associative cache,
+ * indexed by a hash of the word and the exact bits of its inputs. The
+ * least recently used entry of a set is replaced, and an entry is
+ * claimed when the word is called and filled in when it returns. */
+typedef struct entry {
+	int word;
+	int ready;
+	unsigned long age;
+	double values[MEMO_VALUES];
+} entry;
+
+static entry cache[MEMO_SETS][MEMO_WAYS];
+static unsigned long ticks = 0;
+
+static entry *recall(node *n, double *args) {
+	unsigned int h = 2166136261u;
+	unsigned char *p = (unsigned char *) args;
+	int id = n - words;
+	size_t k, size = n->in * sizeof(double);
+	entry *e, *set, *victim;
+
+	for (k = 0; k < sizeof(id); k++) {
+		h = (h ^ ((unsigned char *) &id)[k]) * 16777619u;
+	}
+
+	for (k = 0; k < size; k++) {
+		h = (h ^ p[k]) * 16777619u;
+	}
+
+	set = cache[h % MEMO_SETS];
+	victim = set;
+
+	for (k = 0; k < MEMO_WAYS; k++) {
+		e = &set[k];
+
+		if (e->ready && e->word == id && !memcmp(e->values, args, size)) {
+			e->age = ++ticks;
+			return e;
+		}
+
+		if (e->age < victim->age) {
+			victim = e;
+		}
+	}
+
+	victim->word = id;
+	victim->ready = 0;
+	victim->age = ++ticks;
+	memcpy(victim->values, args, size);
+
+	return victim;
+}
+
+/* Store the results of a word, unless its entry was claimed again. */
+static void remember(entry *e, unsigned long age, double *sp) {
+	node *n = &words[e->word];
+
+	if (e->age != age) {
+		return;
+	}
+
+	memcpy(e->values + n->in, sp - n->out, n->out * sizeof(double));
+	e->ready = 1;
+}
+
+/* Words are called without recursion: the instruction that called a
+ * word is kept in a return stack, and a call right before the end of
+ * a word reuses the frame of its caller. Loops keep their counters in
+ * the same stack. */
+typedef struct frame {
+	inst *ip;
+	int fast;
+	long count;
+	entry *memo;
+	unsigned long age;
+} frame;
+
+static void run(int ip, int fast) {
+	double *base, *sp, t = 0, a, b;
+	inst *i = &code[ip];
+	frame frames[DEPTH_MAX];
+	int rp = 0;
+	entry *e;
+	node *n;
+
+#ifdef THREADED
+	static void *checked[OPCODES] = {
+		[OP_END] = &&L_OP_END,
+		[OP_PUSH] = &&L_OP_PUSH,
+		[OP_CALL] = &&L_OP_CALL,
+		[OP_HOLE] = &&L_OP_HOLE,
+		[OP_ADD] = &&L_OP_ADD,
+		[OP_SUB] = &&L_OP_SUB,
+		[OP_MUL] = &&L_OP_MUL,
+		[OP_DIV] = &&L_OP_DIV,
+		[OP_MOD] = &&L_OP_MOD,
+		[OP_POW] = &&L_OP_POW,
+		[OP_OR] = &&L_OP_OR,
+		[OP_AND] = &&L_OP_AND,
+		[OP_XOR] = &&L_OP_XOR,
+		[OP_SHL] = &&L_OP_SHL,
+		[OP_SHR] = &&L_OP_SHR,
+		[OP_POPCOUNT] = &&L_OP_POPCOUNT,
+		[OP_SUM] = &&L_OP_SUM,
+		[OP_ADDN] = &&L_OP_ADDN,
+		[OP_PROD] = &&L_OP_PROD,
+		[OP_MULN] = &&L_OP_MULN,
+		[OP_MEAN] = &&L_OP_MEAN,
+		[OP_VAR] = &&L_OP_VAR,
+		[OP_STDDEV] = &&L_OP_STDDEV,
+		[OP_MIN] = &&L_OP_MIN,
+		[OP_MAX] = &&L_OP_MAX,
+		[OP_MEDIAN] = &&L_OP_MEDIAN,
+		[OP_PERCENTILE] = &&L_OP_PERCENTILE,
+		[OP_SORT] = &&L_OP_SORT,
+		[OP_RSORT] = &&L_OP_RSORT,
+		[OP_TRANSPOSE] = &&L_OP_TRANSPOSE,
+		[OP_MMUL] = &&L_OP_MMUL,
+		[OP_DET] = &&L_OP_DET,
+		[OP_INV] = &&L_OP_INV,
+		[OP_SOLVE] = &&L_OP_SOLVE,
+		[OP_POLY] = &&L_OP_POLY,
+		[OP_POLYS] = &&L_OP_POLYS,
+		[OP_ABS] = &&L_OP_ABS,
+		[OP_CEIL] = &&L_OP_CEIL,
+		[OP_FLOOR] = &&L_OP_FLOOR,
+		[OP_ROUND] = &&L_OP_ROUND,
+		[OP_SIN] = &&L_OP_SIN,
+		[OP_COS] = &&L_OP_COS,
+		[OP_TAN] = &&L_OP_TAN,
+		[OP_ASIN] = &&L_OP_ASIN,
+		[OP_ACOS] = &&L_OP_ACOS,
+		[OP_ATAN] = &&L_OP_ATAN,
+		[OP_ATAN2] = &&L_OP_ATAN2,
+		[OP_LN] = &&L_OP_LN,
+		[OP_LOG] = &&L_OP_LOG,
+		[OP_ERF] = &&L_OP_ERF,
+		[OP_FACT] = &&L_OP_FACT,
+		[OP_CHOOSE] = &&L_OP_CHOOSE,
+		[OP_LGAMMA] = &&L_OP_LGAMMA,
+		[OP_DUP] = &&L_OP_DUP,
+		[OP_ROLL] = &&L_OP_ROLL,
+		[OP_SWAP] = &&L_OP_SWAP,
+		[OP_DROP] = &&L_OP_DROP,
+		[OP_COUNT] = &&L_OP_COUNT,
+		[OP_CLEAR] = &&L_OP_CLEAR,
+		[OP_STASH] = &&L_OP_STASH,
+		[OP_FETCH] = &&L_OP_FETCH,
+		[OP_STASH1] = &&L_OP_STASH1,
+		[OP_FETCH1] = &&L_OP_FETCH1,
+		[OP_STASHALL] = &&L_OP_STASHALL,
+		[OP_FETCHALL] = &&L_OP_FETCHALL,
+		[OP_SQUARE] = &&L_OP_SQUARE,
+		[OP_NIP] = &&L_OP_NIP,
+		[OP_ADDK] = &&L_OP_ADDK,
+		[OP_SUBK] = &&L_OP_SUBK,
+		[OP_MULK] = &&L_OP_MULK,
+		[OP_DIVK] = &&L_OP_DIVK,
+		[OP_POWK] = &&L_OP_POWK,
+		[OP_LT] = &&L_OP_LT,
+		[OP_GT] = &&L_OP_GT,
+		[OP_LE] = &&L_OP_LE,
+		[OP_GE] = &&L_OP_GE,
+		[OP_EQ] = &&L_OP_EQ,
+		[OP_NE] = &&L_OP_NE,
+		[OP_JUMP] = &&L_OP_JUMP,
+		[OP_JZ] = &&L_OP_JZ,
+		[OP_TIMES] = &&L_OP_TIMES,
+		[OP_LOOP] = &&L_OP_LOOP,
+		[OP_MAP] = &&L_OP_MAP,
+		[OP_GET] = &&L_OP_GET,
+		[OP_SET] = &&L_OP_SET,
+		[OP_RANGE] = &&L_OP_RANGE,
+		[OP_IOTA] = &&L_OP_IOTA,
+		[OP_NUM] = &&L_OP_NUM
+	};
+
+	static void *unchecked[OPCODES] = {
+		[OP_END] = &&L_OP_END,
+		[OP_PUSH] = &&F_OP_PUSH,
+		[OP_CALL] = &&L_OP_CALL,
+		[OP_HOLE] = &&L_OP_HOLE,
+		[OP_ADD] = &&F_OP_ADD,
+		[OP_SUB] = &&F_OP_SUB,
+		[OP_MUL] = &&F_OP_MUL,
+		[OP_DIV] = &&F_OP_DIV,
+		[OP_MOD] = &&F_OP_MOD,
+		[OP_POW] = &&F_OP_POW,
+		[OP_OR] = &&F_OP_OR,
+		[OP_AND] = &&F_OP_AND,
+		[OP_XOR] = &&F_OP_XOR,
+		[OP_SHL] = &&F_OP_SHL,
+		[OP_SHR] = &&F_OP_SHR,
+		[OP_POPCOUNT] = &&F_OP_POPCOUNT,
+		[OP_SUM] = &&L_OP_SUM,
+		[OP_ADDN] = &&L_OP_ADDN,
+		[OP_PROD] = &&L_OP_PROD,
+		[OP_MULN] = &&L_OP_MULN,
+		[OP_MEAN] = &&L_OP_MEAN,
+		[OP_VAR] = &&L_OP_VAR,
+		[OP_STDDEV] = &&L_OP_STDDEV,
+		[OP_MIN] = &&L_OP_MIN,
+		[OP_MAX] = &&L_OP_MAX,
+		[OP_MEDIAN] = &&L_OP_MEDIAN,
+		[OP_PERCENTILE] = &&L_OP_PERCENTILE,
+		[OP_SORT] = &&L_OP_SORT,
+		[OP_RSORT] = &&L_OP_RSORT,
+		[OP_TRANSPOSE] = &&L_OP_TRANSPOSE,
+		[OP_MMUL] = &&L_OP_MMUL,
+		[OP_DET] = &&L_OP_DET,
+		[OP_INV] = &&L_OP_INV,
+		[OP_SOLVE] = &&L_OP_SOLVE,
+		[OP_POLY] = &&L_OP_POLY,
+		[OP_POLYS] = &&L_OP_POLYS,
+		[OP_ABS] = &&F_OP_ABS,
+		[OP_CEIL] = &&F_OP_CEIL,
+		[OP_FLOOR] = &&F_OP_FLOOR,
+		[OP_ROUND] = &&F_OP_ROUND,
+		[OP_SIN] = &&F_OP_SIN,
+		[OP_COS] = &&F_OP_COS,
+		[OP_TAN] = &&F_OP_TAN,
+		[OP_ASIN] = &&F_OP_ASIN,
+		[OP_ACOS] = &&F_OP_ACOS,
+		[OP_ATAN] = &&F_OP_ATAN,
+		[OP_ATAN2] = &&F_OP_ATAN2,
+		[OP_LN] = &&F_OP_LN,
+		[OP_LOG] = &&F_OP_LOG,
+		[OP_ERF] = &&F_OP_ERF,
+		[OP_FACT] = &&F_OP_FACT,
+		[OP_CHOOSE] = &&F_OP_CHOOSE,
+		[OP_LGAMMA] = &&F_OP_LGAMMA,
+		[OP_DUP] = &&F_OP_DUP,
+		[OP_ROLL] = &&L_OP_ROLL,
+		[OP_SWAP] = &&F_OP_SWAP,
+		[OP_DROP] = &&F_OP_DROP,
+		[OP_COUNT] = &&L_OP_COUNT,
+		[OP_CLEAR] = &&L_OP_CLEAR,
+		[OP_STASH] = &&L_OP_STASH,
+		[OP_FETCH] = &&L_OP_FETCH,
+		[OP_STASH1] = &&L_OP_STASH1,
+		[OP_FETCH1] = &&L_OP_FETCH1,
+		[OP_STASHALL] = &&L_OP_STASHALL,
+		[OP_FETCHALL] = &&L_OP_FETCHALL,
+		[OP_SQUARE] = &&F_OP_SQUARE,
+		[OP_NIP] = &&F_OP_NIP,
+		[OP_ADDK] = &&F_OP_ADDK,
+		[OP_SUBK] = &&F_OP_SUBK,
+		[OP_MULK] = &&F_OP_MULK,
+		[OP_DIVK] = &&F_OP_DIVK,
+		[OP_POWK] = &&F_OP_POWK,
+		[OP_LT] = &&F_OP_LT,
+		[OP_GT] = &&F_OP_GT,
+		[OP_LE] = &&F_OP_LE,
+		[OP_GE] = &&F_OP_GE,
+		[OP_EQ] = &&F_OP_EQ,
+		[OP_NE] = &&F_OP_NE,
+		[OP_JUMP] = &&L_OP_JUMP,
+		[OP_JZ] = &&L_OP_JZ,
+		[OP_TIMES] = &&L_OP_TIMES,
+		[OP_LOOP] = &&L_OP_LOOP,
+		[OP_MAP] = &&L_OP_MAP,
+		[OP_GET] = &&L_OP_GET,
+		[OP_SET] = &&L_OP_SET,
+		[OP_RANGE] = &&L_OP_RANGE,
+		[OP_IOTA] = &&L_OP_IOTA,
+		[OP_NUM] = &&L_OP_NUM
+	};
+
+	void **labels = fast ? unchecked : checked;
+#endif
+
+	LOAD();
+
+#ifdef THREADED
+	DISPATCH;
+#else
+dispatch:
+	switch (i->op) {
+#endif
+
+CASE(OP_END):
+	if (rp == 0) {
+		SAVE();
+		return;
+	}
+
+	rp--;
+
+	if (frames[rp].memo != NULL) {
+		if (sp > base) sp[-1] = t;
+		remember(frames[rp].memo, frames[rp].age, sp);
+	}
+
+	i = frames[rp].ip;
+	fast = frames[rp].fast;
+#ifdef THREADED
+	labels = fast ? unchecked : checked;
+#endif
+	NEXT;
+
+CASE(OP_PUSH):
+	ROOM(1);
+FAST(OP_PUSH)
+	RAWPUSH(i->value);
+	NEXT;
+
+CASE(OP_CALL):
+	n = &words[i->arg];
+
+#ifdef JIT
+	if (n->native != NULL && fits(n, sp - base)) {
+		if (sp > base) sp[-1] = t;
+		n->native(sp - n->in);
+		sp += n->out - n->in;
+		if (sp > base) t = sp[-1];
+		NEXT;
+	}
+
+	if (optimize && ++n->calls == HOT_CALLS) {
+		n->native = jit(n);
+	}
+#endif
+
+	e = NULL;
+
+	if (optimize && n->memo && fits(n, sp - base)) {
+		if (sp > base) sp[-1] = t;
+		e = recall(n, sp - n->in);
+
+		if (e->ready) {
+			memcpy(sp - n->in, e->values + n->in, n->out * sizeof(double));
+			sp += n->out - n->in;
+			if (sp > base) t = sp[-1];
+			NEXT;
+		}
+	}
+
+	if (i[1].op != OP_END || e != NULL) {
+		if (rp == DEPTH_MAX) {
+			fprintf(stderr, "\r\nRecursion is too deep!\n");
+			SAVE();
+			return;
+		}
+
+		frames[rp].ip = i;
+		frames[rp].fast = fast;
+		frames[rp].memo = e;
+		frames[rp].age = e != NULL ? e->age : 0;
+		rp++;
+	} else if (limit && --limit == 0) {
+		fprintf(stderr, "\r\nToo many iterations!\n");
+		SAVE();
+		return;
+	}
+
+	i = &code[n->code];
+	fast = fits(n, sp - base);
+#ifdef THREADED
+	labels = fast ? unchecked : checked;
+#endif
+	DISPATCH;
+
+CASE(OP_HOLE):
+	PUSH(hole);
+	NEXT;
+
+CASE(OP_ADD):
+	NEED(2);
+FAST(OP_ADD)
+	BINARY(a + b);
+	NEXT;
+
+CASE(OP_SUB):
+	NEED(2);
+FAST(OP_SUB)
+	BINARY(b - a);
+	NEXT;
+
+CASE(OP_MUL):
+	NEED(2);
+FAST(OP_MUL)
+	BINARY(b * a);
+	NEXT;
+
+CASE(OP_DIV):
+	NEED(2);
+FAST(OP_DIV)
+	BINARY(b / a);
+	NEXT;
+
+CASE(OP_MOD):
+	NEED(2);
+FAST(OP_MOD)
+	BINARY(modulo(b, a));
+	NEXT;
+
+CASE(OP_POW):
+	NEED(2);
+FAST(OP_POW)
+	BINARY(pow(b, a));
+	NEXT;
+
+CASE(OP_OR):
+	NEED(2);
+FAST(OP_OR)
+	BINARY((int)fabs(b)|(int)fabs(a));
+	NEXT;
+
+CASE(OP_AND):
+	NEED(2);
+FAST(OP_AND)
+	BINARY((int)fabs(b)&(int)fabs(a));
+	NEXT;
+
+CASE(OP_XOR):
+	NEED(2);
+FAST(OP_XOR)
+	BINARY((int)fabs(b)^(int)fabs(a));
+	NEXT;
+
+CASE(OP_SHL):
+	NEED(2);
+FAST(OP_SHL)
+	BINARY(shift(b, a));
+	NEXT;
+
+CASE(OP_SHR):
+	NEED(2);
+FAST(OP_SHR)
+	BINARY(floor(shift(b, -a)));
+	NEXT;
+
+CASE(OP_POPCOUNT):
+	NEED(1);
+FAST(OP_POPCOUNT)
+	t = t >= -9223372036854775808.0 && t < 9223372036854775808.0 ?
+		popcount((long long) t) : NAN;
+	NEXT;
+
+CASE(OP_SUM):
+	SAVE();
+	push(s0, add(s0, count(s0)));
+	LOAD();
+	NEXT;
+
+CASE(OP_ADDN):
+	SAVE();
+	push(s0, add(s0, pop(s0)));
+	LOAD();
+	NEXT;
+
+CASE(OP_PROD):
+	SAVE();
+	push(s0, mul(s0, count(s0)));
+	LOAD();
+	NEXT;
+
+CASE(OP_MULN):
+	SAVE();
+	push(s0, mul(s0, pop(s0)));
+	LOAD();
+	NEXT;
+
+CASE(OP_MEAN):
+CASE(OP_VAR):
+CASE(OP_STDDEV):
+CASE(OP_MIN):
+CASE(OP_MAX):
+CASE(OP_MEDIAN):
+	SAVE();
+	push(s0, statistic(s0, i->op));
+	LOAD();
+	NEXT;
+
+CASE(OP_PERCENTILE):
+	SAVE();
+	a = pop(s0);
+	push(s0, percentile(s0, a));
+	LOAD();
+	NEXT;
+
+CASE(OP_SORT):
+CASE(OP_RSORT):
+	SAVE();
+	sort(s0, i->op == OP_RSORT);
+	LOAD();
+	NEXT;
+
+CASE(OP_TRANSPOSE):
+CASE(OP_MMUL):
+CASE(OP_DET):
+CASE(OP_INV):
+CASE(OP_SOLVE):
+	SAVE();
+	matrix(s0, i->op);
+	LOAD();
+	NEXT;
+
+CASE(OP_POLY):
+CASE(OP_POLYS):
+	SAVE();
+	poly(s0, i->op == OP_POLYS);
+	LOAD();
+	NEXT;
+
+CASE(OP_ABS):
+	NEED(1);
+FAST(OP_ABS)
+	t = fabs(t);
+	NEXT;
+
+CASE(OP_CEIL):
+	NEED(1);
+FAST(OP_CEIL)
+	t = ceil(t);
+	NEXT;
+
+CASE(OP_FLOOR):
+	NEED(1);
+FAST(OP_FLOOR)
+	t = floor(t);
+	NEXT;
+
+CASE(OP_ROUND):
+	NEED(1);
+FAST(OP_ROUND)
+	t = round(t);
+	NEXT;
+
+CASE(OP_SIN):
+	NEED(1);
+FAST(OP_SIN)
+	t = sin(t);
+	NEXT;
+
+CASE(OP_COS):
+	NEED(1);
+FAST(OP_COS)
+	t = cos(t);
+	NEXT;
+
+CASE(OP_TAN):
+	NEED(1);
+FAST(OP_TAN)
+	t = tan(t);
+	NEXT;
+
+CASE(OP_ASIN):
+	NEED(1);
+FAST(OP_ASIN)
+	t = asin(t);
+	NEXT;
+
+CASE(OP_ACOS):
+	NEED(1);
+FAST(OP_ACOS)
+	t = acos(t);
+	NEXT;
+
+CASE(OP_ATAN):
+	NEED(1);
+FAST(OP_ATAN)
+	t = atan(t);
+	NEXT;
+
+CASE(OP_ATAN2):
+	NEED(2);
+FAST(OP_ATAN2)
+	BINARY(atan2(b, a));
+	NEXT;
+
+CASE(OP_LN):
+	NEED(1);
+FAST(OP_LN)
+	t = log(t);
+	NEXT;
+
+CASE(OP_LOG):
+	NEED(1);
+FAST(OP_LOG)
+	t = log10(t);
+	NEXT;
+
+CASE(OP_ERF):
+	NEED(1);
+FAST(OP_ERF)
+	t = erf(t);
+	NEXT;
+
+CASE(OP_FACT):
+	NEED(1);
+FAST(OP_FACT)
+	t = factorial(t);
+	NEXT;
+
+CASE(OP_CHOOSE):
+	NEED(2);
+FAST(OP_CHOOSE)
+	BINARY(choose(b, a));
+	NEXT;
+
+CASE(OP_LGAMMA):
+	NEED(1);
+FAST(OP_LGAMMA)
+	t = lgamma(t);
+	NEXT;
+
+CASE(OP_DUP):
+	NEED(1);
+	ROOM(1);
+FAST(OP_DUP)
+	RAWPUSH(t);
+	NEXT;
+
+CASE(OP_ROLL):
+	SAVE();
+	a = pop(s0);
+	b = pop(s0);
+	roll(s0, s1, b, a);
+	LOAD();
+	NEXT;
+
+CASE(OP_SWAP):
+	NEED(2);
+FAST(OP_SWAP)
+	a = t;
+	t = sp[-2];
+	sp[-2] = a;
+	NEXT;
+
+CASE(OP_DROP):
+	NEED(1);
+FAST(OP_DROP)
+	sp--;
+
+	if (sp > base) {
+		t = sp[-1];
+	}
+	NEXT;
+
+CASE(OP_COUNT):
+	PUSH((double) (sp - base));
+	NEXT;
+
+CASE(OP_CLEAR):
+	sp = base;
+	NEXT;
+
+CASE(OP_STASH):
+	SAVE();
+	move(s0, s1, pop(s0));
+	LOAD();
+	NEXT;
+
+CASE(OP_FETCH):
+	SAVE();
+	move(s1, s0, pop(s0));
+	LOAD();
+	NEXT;
+
+CASE(OP_STASH1):
+	SAVE();
+	move(s0, s1, 1);
+	LOAD();
+	NEXT;
+
+CASE(OP_FETCH1):
+	SAVE();
+	move(s1, s0, 1);
+	LOAD();
+	NEXT;
+
+CASE(OP_STASHALL):
+	SAVE();
+	move(s0, s1, count(s0));
+	LOAD();
+	NEXT;
+
+CASE(OP_FETCHALL):
+	SAVE();
+	move(s1, s0, count(s1));
+	LOAD();
+	NEXT;
+
+CASE(OP_SQUARE):
+	NEED(1);
+	FULL(b * a);
+FAST(OP_SQUARE)
+	t = t * t;
+	NEXT;
+
+CASE(OP_NIP):
+	NEED(1);
+
+	if (sp - base == 1) {
+		sp--;
+		NEXT;
+	}
+FAST(OP_NIP)
+	sp--;
+	NEXT;
+
+CASE(OP_ADDK):
+	if (sp == base) {
+		PUSH(i->value);
+		NEXT;
+	}
+
+	FULL(b + a);
+FAST(OP_ADDK)
+	t = i->value + t;
+	NEXT;
+
+CASE(OP_SUBK):
+	if (sp == base) {
+		PUSH(i->value);
+		NEXT;
+	}
+
+	FULL(b - a);
+FAST(OP_SUBK)
+	t = t - i->value;
+	NEXT;
+
+CASE(OP_MULK):
+	if (sp == base) {
+		PUSH(i->value);
+		NEXT;
+	}
+
+	FULL(b * a);
+FAST(OP_MULK)
+	t = t * i->value;
+	NEXT;
+
+CASE(OP_DIVK):
+	if (sp == base) {
+		PUSH(i->value);
+		NEXT;
+	}
+
+	FULL(b / a);
+FAST(OP_DIVK)
+	t = t / i->value;
+	NEXT;
+
+CASE(OP_POWK):
+	if (sp == base) {
+		PUSH(i->value);
+		NEXT;
+	}
+
+	FULL(pow(b, a));
+FAST(OP_POWK)
+	t = i->value == 2 ? t * t : pow(t, i->value);
+	NEXT;
+
+CASE(OP_LT):
+	NEED(2);
+FAST(OP_LT)
+	BINARY(b < a);
+	NEXT;
+
+CASE(OP_GT):
+	NEED(2);
+FAST(OP_GT)
+	BINARY(b > a);
+	NEXT;
+
+CASE(OP_LE):
+	NEED(2);
+FAST(OP_LE)
+	BINARY(b <= a);
+	NEXT;
+
+CASE(OP_GE):
+	NEED(2);
+FAST(OP_GE)
+	BINARY(b >= a);
+	NEXT;
+
+CASE(OP_EQ):
+	NEED(2);
+FAST(OP_EQ)
+	BINARY(b == a);
+	NEXT;
+
+CASE(OP_NE):
+	NEED(2);
+FAST(OP_NE)
+	BINARY(b != a);
+	NEXT;
+
+CASE(OP_JUMP):
+	if (i->arg < 0 && limit && --limit == 0) {
+		fprintf(stderr, "\r\nToo many iterations!\n");
+		SAVE();
+		return;
+	}
+
+	if (i->arg < 0 && nnums > watermark) {
+		SAVE();
+		compact();
+		LOAD();
+	}
+
+	i += i->arg;
+	DISPATCH;
+
+CASE(OP_JZ):
+	a = 0;
+
+	if (sp > base) {
+		a = t;
+		sp--;
+
+		if (sp > base) {
+			t = sp[-1];
+		}
+	}
+
+	if (a == 0) {
+		i += i->arg;
+		DISPATCH;
+	}
+	NEXT;
+
+CASE(OP_TIMES):
+	a = 0;
+
+	if (sp > base) {
+		a = t;
+		sp--;
+
+		if (sp > base) {
+			t = sp[-1];
+		}
+	}
+
+	if (a < 1) {
+		i += i->arg;
+		DISPATCH;
+	}
+
+	if (rp == DEPTH_MAX) {
+		fprintf(stderr, "\r\nRecursion is too deep!\n");
+		SAVE();
+		return;
+	}
+
+	frames[rp].ip = NULL;
+	frames[rp].count = a;
+	frames[rp].memo = NULL;
+	rp++;
+	NEXT;
+
+CASE(OP_LOOP):
+	if (--frames[rp-1].count > 0) {
+		if (limit && --limit == 0) {
+			fprintf(stderr, "\r\nToo many iterations!\n");
+			SAVE();
+			return;
+		}
+
+		if (nnums > watermark) {
+			SAVE();
+			compact();
+			LOAD();
+		}
+
+		i += i->arg;
+		DISPATCH;
+	}
+
+	rp--;
+	NEXT;
+
+CASE(OP_MAP):
+	SAVE();
+	map(i + 1);
+	LOAD();
+	i += i->arg;
+	DISPATCH;
+
+CASE(OP_RANGE):
+	SAVE();
+	a = pop(s0);
+	b = pop(s0);
+	i = series(i, b, a < b ? -1 : 1, floor(fabs(a - b)) + 1);
+
+	if (i == NULL) {
+		return;
+	}
+
+	LOAD();
+	NEXT;
+
+CASE(OP_IOTA):
+	SAVE();
+	i = series(i, 1, 1, floor(pop(s0)));
+
+	if (i == NULL) {
+		return;
+	}
+
+	LOAD();
+	NEXT;
+
+CASE(OP_NUM):
+	SAVE();
+	calc(i);
+	LOAD();
+	NEXT;
+
+CASE(OP_GET):
+	PUSH(regs[i->arg]);
+	NEXT;
+
+CASE(OP_SET):
+	NEED(1);
+	regs[i->arg] = t;
+	sp--;
+
+	if (sp > base) {
+		t = sp[-1];
+	}
+	NEXT;
+
+#ifndef THREADED
+	}
+
+next:
+	i++;
+	goto dispatch;
+#endif
+}
+
+/* Drop the numbers that are no longer referenced, moving the rest to
+ * the front of the arena. Called between evaluations, and at the back
+ * edge of a loop once the arena is past its watermark, when the only
+ * references are in the stacks, the registers, the hole, the code and
+ * the stacks of the maps that are running. */
+static void relocate(double *x, int *to, int pass) {
+	if (pass == 0) {
+		to[(int) *x] = 1;
+	} else {
+		*x = to[(int) *x];
+	}
+}
+
+static void compact() {
+	int j, k, pass;
+	int *to;
+	root *o;
+
+	if (mode == MODE_DOUBLE) {
+		return;
+	}
+
+	to = (int *) calloc(nnums, sizeof(int));
+
+	if (to == NULL) {
+		fprintf(stderr, "Not enough memory for numbers\n");
+		exit(1);
+	}
+
+	to[0] = 1;
+
+	for (pass = 0; pass < 2; pass++) {
+		for (k = 0; k < count(s0); k++) {
+			relocate(&s0->items[k], to, pass);
+		}
+
+		for (k = 0; k < count(s1); k++) {
+			relocate(&s1->items[k], to, pass);
+		}
+
+		for (k = 0; k < REGS_MAX; k++) {
+			relocate(&regs[k], to, pass);
+		}
+
+		for (k = 0; k < ncode; k++) {
+			if (code[k].op == OP_NUM && code[k].arg == OP_PUSH) {
+				relocate(&code[k].value, to, pass);
+			}
+		}
+
+		for (o = roots; o != NULL; o = o->next) {
+			for (k = 0; k < count(o->s); k++) {
+				relocate(&o->s->items[k], to, pass);
+			}
+		}
+
+		relocate(&hole, to, pass);
+
+		if (pass == 0) {
+			for (j = k = 0; k < nnums; k++) {
+				if (to[k]) {
+					nums[j] = nums[k];
+					to[k] = j++;
+				} else {
+					release(&nums[k]);
+				}
+			}
+
+			nnums = j;
+		}
+	}
+
+	watermark = nnums * 2 > NUMS_MIN ? nnums * 2 : NUMS_MIN;
+	free(to);
+}
+
+static void eval(const char *input) {
+	node n;
+
+	compact();
+
+	n.code = compile(input, NULL);
+	n.size = ncode - n.code - 1;
+	measure(&n);
+
+	run(n.code, fits(&n, count(s0)));
+
+	ncode = n.code;
+}
+
+/* Translation to C
+ *
+ * A word or expression with a static stack effect can be exported as
+ * a C function. The instructions are executed on a stack of C
+ * expressions: each operation declares a temporary with its result,
+ * and the exprs it needs below the ones available become parameters,
+ * named x1 for the top of the stack, x2 for the next one, and so on. */
+static sds *exprs = NULL;
+static int nexprs = 0;
+static int inputs = 0;
+static int temps = 0;
+
+/* Set when the code needs the table of factorials. */
+static int facts = 0;
+
+static void give(sds expr) {
+	exprs = (sds *) realloc(exprs, (nexprs + 1) * sizeof(sds));
+
+	if (exprs == NULL) {
+		fprintf(stderr, "Not enough memory to translate\n");
+		exit(1);
+	}
+
+	exprs[nexprs++] = expr;
+}
+
+static sds take() {
+	return exprs[--nexprs];
+}
+
+/* Make sure there are at least n exprs, adding parameters if needed. */
+static void need(int n) {
+	int i, k = n - nexprs;
+
+	if (k <= 0) {
+		return;
+	}
+
+	exprs = (sds *) realloc(exprs, n * sizeof(sds));
+
+	if (exprs == NULL) {
+		fprintf(stderr, "Not enough memory to translate\n");
+		exit(1);
+	}
+
+	memmove(exprs + k, exprs, nexprs * sizeof(sds));
+
+	for (i = 0; i < k; i++) {
+		exprs[k - i - 1] = sdscatprintf(sdsempty(), "x%d", ++inputs);
+	}
+
+	nexprs = n;
+}
+
+static sds literal(double value) {
+	if (isnan(value)) {
+		return sdsnew("NAN");
+	}
+
+	if (isinf(value)) {
+		return sdsnew(value > 0 ? "INFINITY" : "-INFINITY");
+	}
+
+	return sdscatprintf(sdsempty(), "%.17g", value);
+}
+
+/* Declare a temporary for the result of an operation on the exprs a
+ * and b, where a was at the top of the stack. */
+static void temp(sds *body, const char *fmt, sds a, sds b) {
+	sds t = sdscatprintf(sdsempty(), "t%d", ++temps);
+
+	*body = sdscatprintf(*body, "\tdouble %s = ", t);
+	*body = sdscatprintf(*body, fmt, a, b == NULL ? a : b);
+	*body = sdscat(*body, ";\n");
+
+	sdsfree(a);
+
+	if (b != NULL) {
+		sdsfree(b);
+	}
+
+	give(t);
+}
+
+static int translate(int ip, sds *body, int level) {
+	sds a, b;
+	inst *i;
+
+	if (level == DEPTH_MAX) {
+		return 1;
+	}
+
+	for (i = &code[ip]; i->op != OP_END; i++) {
+		need(effects[i->op].in);
+
+		switch (i->op) {
+		case OP_PUSH:
+			give(literal(i->value));
+			break;
+		case OP_CALL:
+			if (translate(words[i->arg].code, body, level + 1) != 0) {
+				return 1;
+			}
+			break;
+		case OP_ADD:
+			a = take(); b = take();
+			temp(body, "%1$s + %2$s", a, b);
+			break;
+		case OP_SUB:
+			a = take(); b = take();
+			temp(body, "%2$s - %1$s", a, b);
+			break;
+		case OP_MUL:
+			a = take(); b = take();
+			temp(body, "%2$s * %1$s", a, b);
+			break;
+		case OP_DIV:
+			a = take(); b = take();
+			temp(body, "%2$s / %1$s", a, b);
+			break;
+		case OP_MOD:
+			a = take(); b = take();
+			temp(body, "%2$s - %1$s * floor(%2$s / %1$s)", a, b);
+			break;
+		case OP_POW:
+			a = take(); b = take();
+			temp(body, "pow(%2$s, %1$s)", a, b);
+			break;
+		case OP_OR:
+			a = take(); b = take();
+			temp(body, "(int) fabs(%2$s) | (int) fabs(%1$s)", a, b);
+			break;
+		case OP_AND:
+			a = take(); b = take();
+			temp(body, "(int) fabs(%2$s) & (int) fabs(%1$s)", a, b);
+			break;
+		case OP_XOR:
+			a = take(); b = take();
+			temp(body, "(int) fabs(%2$s) ^ (int) fabs(%1$s)", a, b);
+			break;
+		case OP_ATAN2:
+			a = take(); b = take();
+			temp(body, "atan2(%2$s, %1$s)", a, b);
+			break;
+		case OP_LT:
+			a = take(); b = take();
+			temp(body, "%2$s < %1$s", a, b);
+			break;
+		case OP_GT:
+			a = take(); b = take();
+			temp(body, "%2$s > %1$s", a, b);
+			break;
+		case OP_LE:
+			a = take(); b = take();
+			temp(body, "%2$s <= %1$s", a, b);
+			break;
+		case OP_GE:
+			a = take(); b = take();
+			temp(body, "%2$s >= %1$s", a, b);
+			break;
+		case OP_EQ:
+			a = take(); b = take();
+			temp(body, "%2$s == %1$s", a, b);
+			break;
+		case OP_NE:
+			a = take(); b = take();
+			temp(body, "%2$s != %1$s", a, b);
+			break;
+		case OP_ABS:
+			temp(body, "fabs(%1$s)", take(), NULL);
+			break;
+		case OP_CEIL:
+			temp(body, "ceil(%1$s)", take(), NULL);
+			break;
+		case OP_FLOOR:
+			temp(body, "floor(%1$s)", take(), NULL);
+			break;
+		case OP_ROUND:
+			temp(body, "round(%1$s)", take(), NULL);
+			break;
+		case OP_SIN:
+			temp(body, "sin(%1$s)", take(), NULL);
+			break;
+		case OP_COS:
+			temp(body, "cos(%1$s)", take(), NULL);
+			break;
+		case OP_TAN:
+			temp(body, "tan(%1$s)", take(), NULL);
+			break;
+		case OP_ASIN:
+			temp(body, "asin(%1$s)", take(), NULL);
+			break;
+		case OP_ACOS:
+			temp(body, "acos(%1$s)", take(), NULL);
+			break;
+		case OP_ATAN:
+			temp(body, "atan(%1$s)", take(), NULL);
+			break;
+		case OP_LN:
+			temp(body, "log(%1$s)", take(), NULL);
+			break;
+		case OP_LOG:
+			temp(body, "log10(%1$s)", take(), NULL);
+			break;
+		case OP_ERF:
+			temp(body, "erf(%1$s)", take(), NULL);
+			break;
+		case OP_FACT:
+			temp(body, "factorial(%1$s)", take(), NULL);
+			facts = 1;
+			break;
+		case OP_LGAMMA:
+			temp(body, "lgamma(%1$s)", take(), NULL);
+			break;
+		case OP_SQUARE:
+			temp(body, "%1$s * %1$s", take(), NULL);
+			break;
+		case OP_ADDK:
+			temp(body, "%2$s + %1$s", take(), literal(i->value));
+			break;
+		case OP_SUBK:
+			temp(body, "%1$s - %2$s", take(), literal(i->value));
+			break;
+		case OP_MULK:
+			temp(body, "%1$s * %2$s", take(), literal(i->value));
+			break;
+		case OP_DIVK:
+			temp(body, "%1$s / %2$s", take(), literal(i->value));
+			break;
+		case OP_POWK:
+			if (i->value == 2) {
+				temp(body, "%1$s * %1$s", take(), NULL);
+			} else {
+				temp(body, "pow(%1$s, %2$s)", take(), literal(i->value));
+			}
+			break;
+		case OP_DUP:
+			a = take();
+			give(sdsdup(a));
+			give(a);
+			break;
+		case OP_SWAP:
+			a = take(); b = take();
+			give(a);
+			give(b);
+			break;
+		case OP_DROP:
+			sdsfree(take());
+			break;
+		case OP_NIP:
+			a = take();
+			sdsfree(take());
+			give(a);
+			break;
+		default:
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+/* Print a C function equivalent to the input, named after it if the
+ * input is a word. */
+static int emit_c(const char *input) {
+	sds body = sdsempty();
+	sds fname = sdsnew("clac_");
+	int i, n, start = compile(input, NULL);
+
+	if (translate(start, &body, 0) != 0) {
+		fprintf(stderr, "Can't translate \"%s\" to C\n", input);
+		return 1;
+	}
+
+	if (get(input) != NULL) {
+		for (i = 0; input[i] != '\0'; i++) {
+			fname = sdscatlen(fname, isalnum(input[i]) ? &input[i] : "_", 1);
+		}
+	} else {
+		fname = sdscat(fname, "expr");
+	}
+
+	printf("#include <math.h>\n\n");
+
+	if (facts) {
+		n = sizeof(factorials) / sizeof(double);
+		printf("static const double factorials[] = {");
+
+		for (i = 0; i < n; i++) {
+			printf("%s%.17g", i == 0 ? "\n\t" : i % 3 ? ", " : ",\n\t",
+				factorials[i]);
+		}
+
+		printf("\n};\n\n");
+		printf("static double factorial(double a) {\n");
+		printf("\tif (a >= 0 && a <= %d && a == floor(a)) {\n", n - 1);
+		printf("\t\treturn factorials[(int) a];\n\t}\n\n");
+		printf("\treturn a * tgamma(a);\n}\n\n");
+	}
+
+	printf("/* %s ( ", input);
+
+	for (i = inputs; i > 0; i--) {
+		printf("x%d ", i);
+	}
+
+	printf("--");
+
+	for (i = 0; i < nexprs; i++) {
+		printf(" out[%d]", i);
+	}
+
+	printf(" ) */\n");
+	printf("void %s(", fname);
+
+	for (i = inputs; i > 0; i--) {
+		printf("double x%d, ", i);
+	}
+
+	printf("double *out) {\n%s", body);
+
+	for (i = 0; i < nexprs; i++) {
+		printf("\tout[%d] = %s;\n", i, exprs[i]);
+		sdsfree(exprs[i]);
+	}
+
+	printf("}\n");
+
+	free(exprs);
+	sdsfree(body);
+	sdsfree(fname);
+
+	return 0;
+}
+
+static sds buildpath(const char *fmt, const char *dir) {
+	return sdscatfmt(sdsempty(), fmt, dir, WORDS_FILE);
+}
+
+static int config() {
+	sdsfree(path);
+	path = NULL;
+
+	if (getenv("CLAC_WORDS") != NULL) {
+		path = sdsnew(getenv("CLAC_WORDS"));
+	} else if (getenv("XDG_CONFIG_HOME") != NULL) {
+		path = buildpath("%s/%s", getenv("XDG_CONFIG_HOME"));
+	} else if (getenv("HOME") != NULL) {
+		path = buildpath("%s/.config/%s", getenv("HOME"));
+	}
+
+	if (path && load(path) != 0) {
+		return 1;
+	}
+
+	build();
+
+	return 0;
+}
+
+/* Apply new definitions to the current dictionary, where no word was
+ * removed. Words keep their places, so code that calls them by index
+ * stays valid, and only the words whose meaning changed, the new ones
+ * and the ones that use them, directly or not, are compiled again.
+ * Their new code goes at the end of the buffer. */
+static void relink(sds *defs, int n) {
+	char *stale = (char *) calloc(nwords + n + 1, 1);
+	int i, j, argc, more;
+	sds *argv;
+	node *w;
+
+	if (stale == NULL) {
+		fprintf(stderr, "Not enough memory to load words\n");
+		exit(1);
+	}
+
+	for (i = 0; i < n; i++) {
+		if ((w = get(defs[2*i])) == NULL) {
+			set(defs[2*i], defs[2*i+1]);
+			stale[nwords-1] = 1;
+		} else if (strcmp(meaning(w), defs[2*i+1])) {
+			w->meaning = intern(defs[2*i+1], -1);
+			stale[w - words] = 1;
+		}
+	}
+
+	do {
+		for (more = 0, i = 0; i < nwords; i++) {
+			if (stale[i]) {
+				continue;
+			}
+
+			argv = sdssplitargs(meaning(&words[i]), &argc);
+
+			for (j = 0; j < argc; j++) {
+				if ((w = get(argv[j])) != NULL && stale[w - words]) {
+					stale[i] = more = 1;
+					break;
+				}
+			}
+
+			sdsfreesplitres(argv, argc);
+		}
+	} while (more);
+
+	for (i = 0; i < nwords; i++) {
+		if (stale[i]) {
+			declare(meaning(&words[i]));
+			words[i].state = PENDING;
+#ifdef JIT
+			unload(&words[i], 1);
+			words[i].native = NULL;
+			words[i].calls = 0;
+#endif
+		}
+	}
+
+	for (i = 0; i < nwords; i++) {
+		if (stale[i]) {
+			compileword(&words[i]);
+		}
+	}
+
+	free(stale);
+}
+
+/* Load the words file into a fresh dictionary, and only discard the
+ * current one if the new definitions are correct. When no word was
+ * removed, the new definitions are applied to the current dictionary
+ * instead, so only what changed is compiled again. */
+static void reload() {
+	node *w = words;
+	inst *c = code;
+	int n = nwords;
+	int m = maxwords;
+	int nc = ncode;
+	int mc = maxcode;
+	sds p = pool;
+	bucket *t = table;
+	int ns = nbuckets;
+	int ms = maxbuckets;
+	sds *defs;
+	int i, k;
+
+	words = NULL;
+	code = NULL;
+	pool = NULL;
+	table = NULL;
+	nwords = 0;
+	maxwords = 0;
+	ncode = 0;
+	maxcode = 0;
+	nbuckets = 0;
+	maxbuckets = 0;
+
+	if (path != NULL && load(path) != 0) {
+		cleanup();
+
+		words = w;
+		code = c;
+		pool = p;
+		table = t;
+		nwords = n;
+		maxwords = m;
+		ncode = nc;
+		maxcode = mc;
+		nbuckets = ns;
+		maxbuckets = ms;
+		return;
+	}
+
+	for (i = 0; i < n && get(p + w[i].word) != NULL; i++);
+
+	if (i < n) {
+		build();
+
+		unload(w, n);
+		free(w);
+		free(c);
+		sdsfree(p);
+		free(t);
+
+		memset(cache, 0, sizeof(cache));
+		return;
+	}
+
+	k = nwords;
+	defs = (sds *) malloc((2 * k + 1) * sizeof(sds));
+
+	if (defs == NULL) {
+		fprintf(stderr, "Not enough memory to load words\n");
+		exit(1);
+	}
+
+	for (i = 0; i < k; i++) {
+		defs[2*i] = sdsnew(name(&words[i]));
+		defs[2*i+1] = sdsnew(meaning(&words[i]));
+	}
+
+	cleanup();
+
+	words = w;
+	code = c;
+	pool = p;
+	table = t;
+	nwords = n;
+	maxwords = m;
+	ncode = nc;
+	maxcode = mc;
+	nbuckets = ns;
+	maxbuckets = ms;
+
+	relink(defs, k);
+
+	for (i = 0; i < 2 * k; i++) {
+		sdsfree(defs[i]);
+	}
+
+	free(defs);
+	memset(cache, 0, sizeof(cache));
+}
+
+/* Check if the words file was modified since it was last loaded. On
+ * Linux the directory of the file is watched with inotify, so editors
+ * that replace the file are noticed too, and otherwise the status of
+ * the file is compared with the one it had when it was loaded. */
+#ifdef WATCH
+static int watcher = -1;
+
+static void watch() {
+	sds dir;
+	char *slash;
+
+	if (path == NULL) {
+		return;
+	}
+
+	if ((watcher = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) == -1) {
+		return;
+	}
+
+	slash = strrchr(path, '/');
+	dir = slash ? sdsnewlen(path, slash - path + 1) : sdsnew(".");
+
+	if (inotify_add_watch(watcher, dir, IN_CLOSE_WRITE | IN_MOVED_TO |
+			IN_CREATE | IN_DELETE | IN_ATTRIB) == -1) {
+		close(watcher);
+		watcher = -1;
+	}
+
+	sdsfree(dir);
+}
+
+static int notified() {
+	union {
+		struct inotify_event e;
+		char buf[4096];
+	} u;
+	const char *file = strrchr(path, '/') ? strrchr(path, '/') + 1 : path;
+	struct inotify_event *e;
+	ssize_t len;
+	char *q;
+	int found = 0;
+
+	while ((len = read(watcher, u.buf, sizeof(u.buf))) > 0) {
+		for (q = u.buf; q < u.buf + len; q += sizeof(*e) + e->len) {
+			e = (struct inotify_event *) q;
+
+			if (e->mask & IN_IGNORED) {
+				close(watcher);
+				watcher = -1;
+				return 1;
+			}
+
+			if (e->len > 0 && !strcmp(e->name, file)) {
+				found = 1;
+			}
+		}
+	}
+
+	return found;
+}
+#endif
+
+static int modified() {
+	struct stat st;
+
+#ifdef WATCH
+	if (watcher != -1) {
+		return notified() && stat(path, &st) == 0;
+	}
+#endif
+
+	if (path == NULL || stat(path, &st) != 0) {
+		return 0;
+	}
+
+	return st.st_mtime != info.st_mtime ||
+		st.st_size != info.st_size ||
+		st.st_ino != info.st_ino;
+}
+
+static void completion(const char *input, linenoiseCompletions *lc) {}
+
+/* Evaluate the input as it's typed, with the words file as it is
+ * now, forgetting the registers it declares, since their names may be
+ * incomplete. */
+static char *hints(const char *input, int *color, int *bold) {
+	int i, n = nregs;
+
+	if (modified()) {
+		reload();
+	}
+
+	clear(s0);
+	clear(s1);
+	memset(regs, 0, sizeof(regs));
+
+	limit = LOOPS_MAX;
+	eval(input);
+	limit = 0;
+	sdsclear(result);
+
+	while (nregs > n) {
+		sdsfree(regnames[--nregs]);
+	}
+
+	result = sdscat(result, " ");
+
+	for (i = 0; i < count(s0); i++) {
+		result = sdscat(result, " ");
+		result = format(result, s0->items[i]);
+	}
+
+	if (!isempty(s1)) {
+		result = sdscat(result, " ⋮");
+
+		for (i = s1->top-1; i > -1; i--) {
+			result = sdscat(result, " ");
+			result = format(result, s1->items[i]);
+		}
+	}
+
+	*color = HINT_COLOR;
+
+	return result;
+}
+
+int main(int argc, char **argv) {
+	char *line;
+	int k;
+
+	result = sdsempty();
+
+	if (getenv("CLAC_NOOPT") != NULL) {
+		optimize = 0;
+	}
+
+	if (getenv("CLAC_LIBM") != NULL) {
+		exact = 1;
+	}
+
+	if (getenv("CLAC_MODE") != NULL) {
+		for (mode = 0; mode < MODES; mode++) {
+			if (!strcasecmp(getenv("CLAC_MODE"), modes[mode])) {
+				break;
+			}
+		}
+
+		if (mode == MODES) {
+			fprintf(stderr, "Unknown mode \"%s\"\n", getenv("CLAC_MODE"));
+			exit(1);
+		}
+	}
+
+	if (getenv("CLAC_SCALE") != NULL) {
+		scale = atoi(getenv("CLAC_SCALE"));
+		scale = scale < 0 ? 0 : scale > SCALE_MAX ? SCALE_MAX : scale;
+	}
+
+	for (unit = 1, k = 0; k < scale; k++) {
+		unit *= 10;
+	}
+
+	if (getenv("CLAC_PRECISION") != NULL) {
+		precision = atoi(getenv("CLAC_PRECISION"));
+
+		if (precision < 1) {
+			precision = 1;
+		}
+	}
+
+	box(integer(0));
+
+	if (config() != 0) {
+		exit(1);
+	}
+
+	if (argc == 2) {
+		eval(argv[1]);
+
+		while (count(s0) > 0) {
+			sdsclear(result);
+			result = format(result, pop(s0));
+			printf("%s\n", result);
+		}
+
+		exit(0);
+	}
+
+	if (argc == 3 && !strcmp(argv[1], "--emit-c")) {
+		exit(emit_c(argv[2]));
+	}
+
+	if (argc > 2) {
+		fprintf(stderr, "usage: clac [expression]\n");
+		fprintf(stderr, "       clac --emit-c expression\n");
+		exit(1);
+	}
+
+	linenoiseSetHintsCallback(hints);
+	linenoiseSetCompletionCallback(completion);
+#ifdef WATCH
+	watch();
+#endif
+
+	while((line = linenoise("> ")) != NULL) {
+		if (modified()) {
+			reload();
+		}
 
-	while((line = linenoise("> ")) != NULL) {
 		if (!strcmp(line, "words")) {
-			node *curr = head;
+			int i;
 
-			while (curr != NULL) {
-				printf(WORDEF_FMT, curr->word, curr->meaning);
-				curr = curr->next;
+			for (i = 0; i < nwords; i++) {
+				printf(WORDEF_FMT, name(&words[i]), meaning(&words[i]));
 			}
 		} else if (!strcmp(line, "reload")) {
-			cleanup();
-			config();
+			reload();
 		} else if (!isempty(s0)) {
 			hole = peek(s0);
 			clear(s0);
-			printf(OUTPUT_FMT, hole);
+			sdsclear(result);
+			result = format(result, hole);
+			printf(OUTPUT_FMT, result);
 		}
 
 		sdsclear(result);
@@ -585,6 +6624,7 @@ int main(int argc, char **argv) {
 	}
 
 	sdsfree(result);
+	sdsfree(path);
 	cleanup();
 
 	return 0;
@@ -0,0 +1,33 @@
+/* Show hints for the first argument as if it was being typed, then
+ * evaluate the second one and print the number of items left. With a
+ * third argument, the words are reloaded from that file first. */
+#define main clac
+#include "../clac.c"
+#undef main
+
+int main(int argc, char **argv) {
+	int color, bold;
+
+	result = sdsempty();
+
+	if (argc != 3 && argc != 4) {
+		return 1;
+	}
+
+	if (config() != 0) {
+		return 1;
+	}
+
+	if (argc == 4) {
+		sdsfree(path);
+		path = sdsnew(argv[3]);
+		reload();
+	}
+
+	hints(argv[1], &color, &bold);
+	clear(s0);
+	eval(argv[2]);
+	printf("%d\n", count(s0));
+
+	return 0;
+}
@@ -27,6 +27,9 @@ assert_equal "3.141592" `./clac pi`
 # Word defined based on user defined word
 assert_equal "6.283184" `./clac tau`
 
+# Word calling a constant word that pushes many values
+assert_equal "83" `./clac "dozens five sum"`
+
 # Not found words starting with digits result in nan
 assert_equal "nan" `./clac 3+`
 
@@ -67,3 +70,100 @@ assert_equal "" `./clac "1 roll"`
 assert_equal "2" `./clac "2.1 round"`
 assert_equal "2" `./clac "2.1 floor"`
 assert_equal "3" `./clac "2.1 ceil"`
+
+# Control flow
+assert_equal "1" `./clac "2 3 <"`
+assert_equal "6" `./clac "0 if 5 else 6 then"`
+assert_equal "32" `./clac "1 5 times 2 * end"`
+assert_equal "128" `./clac "1 begin dup 100 < while 2 * end"`
+assert_equal "2048" `./clac "10 pow2 10 pow2 +"`
+
+# Registers
+assert_equal "25" `./clac "3 >a 4 >b a a * b b * +"`
+assert_equal "2" `./clac "2 >pi count" | head -1`
+assert_equal "10" `./clac "1 2 3 map dup * 1 + end"`
+assert_equal "5" `./clac "1 map 0 > if 5 then end"`
+assert_equal "2" `./clac "1 2 map dup sin dup * swap cos dup * + end +"`
+
+# Fused operations on a full stack
+assert_equal "64770" `./clac "255 iota dup *" 2>/dev/null | head -1`
+assert_equal "509" `./clac "255 iota 1 +" 2>/dev/null | head -1`
+assert_equal "254" `./clac "255 iota dup drop" 2>/dev/null | head -1`
+
+# Hints don't declare registers
+assert_equal "0" `./test/hints ">ab" "ab"`
+assert_equal "1" `./test/hints ">ab" "1 >ab ab"`
+
+# Reloading changed, added and removed words
+assert_equal "1" `./test/hints "" "tau 6 = if 1 then" test/relink`
+assert_equal "1" `./test/hints "" "six 6 = if 1 then" test/relink`
+assert_equal "0" `./test/hints "" "tau" test/missing`
+
+# Factorials
+assert_equal "355687428096000" `./clac "17 !"`
+assert_equal "0.886226925452758" `./clac "0.5 !"`
+assert_equal "1225" `./clac "50 2 choose"`
+assert_equal "-10" `./clac "-3 3 choose"`
+assert_equal "465428353255261088" `CLAC_MODE=int ./clac "62 31 choose"`
+assert_equal "5905.22042320918" `./clac "1000 lgamma"`
+
+# Sequences
+assert_equal "10" `./clac "4 iota sum"`
+assert_equal "5000050000" `./clac "1 100000 range sum"`
+assert_equal "333833500" `./clac "1000 1 range map 2 ^ end sum"`
+
+# Statistics
+assert_equal "2.5" `./clac "1 2 3 4 mean"`
+assert_equal "2.1380899352994" `./clac "2 4 4 4 5 5 7 9 stddev"`
+assert_equal "3" `./clac "5 3 1 4 2 median"`
+assert_equal "3.7" `./clac "1 2 3 4 90 percentile"`
+assert_equal "83333416666.6667" `./clac "1 1000000 range var"`
+
+# Sorting
+assert_equal "1" `./clac "2 3 1 sort drop drop"`
+assert_equal "3" `./clac "2 3 1 rsort drop drop"`
+assert_equal "-1" `./clac "1 100 range map 37 * 101 % end sort 98 stash -"`
+assert_equal "1" `./clac "1 100 range map 37 * 101 % end rsort 98 stash -"`
+assert_equal "0.5" `CLAC_MODE=int ./clac "0.5 -2 3 sort drop swap drop"`
+
+# Matrices
+assert_equal "-2" `./clac "1 2 3 4 2 det"`
+assert_equal "-3" `./clac "1 2 3 4 5 6 2 3 transpose 4 stash -"`
+assert_equal "11" `./clac "1 2 3 4 5 6 3 2 2 2 2 mmul 3 stash"`
+assert_equal "0.6" `./clac "4 7 2 6 2 inv 3 stash"`
+assert_equal "-2" `./clac "2 1 1 3 5 10 2 solve -"`
+assert_equal "0" `./clac "1 2 3 4 5 6 7 8 9 3 det"`
+assert_equal "inf" `./clac "1 2 3 4 5 6 7 8 9 3 inv abs" | head -1`
+
+# Polynomials
+assert_equal "17" `./clac "2 3 2 1 3 poly"`
+assert_equal "26" `./clac "1 2 3 4 1 0 -1 3 polys sum"`
+assert_equal "1.11" `CLAC_MODE=decimal ./clac "0.1 1 1 1 3 poly"`
+
+# Integer mode
+assert_equal "1024" `./clac "1 10 <<"`
+assert_equal "9007199254740993" `CLAC_MODE=int ./clac "2 53 ^ 1 +"`
+assert_equal "-1" `CLAC_MODE=int ./clac "-1 0xff00 or"`
+assert_equal "64" `CLAC_MODE=int ./clac "-1 popcount"`
+assert_equal "9.22337203685478e+18" `CLAC_MODE=int ./clac "9223372036854775807 1 +"`
+assert_equal "9.22337203685478e+18" `CLAC_MODE=int ./clac "1 63 <<"`
+assert_equal "4611686018427387904" `CLAC_MODE=int ./clac "1 62 <<"`
+
+# Decimal mode
+assert_equal "0.3" `CLAC_MODE=decimal ./clac "0.1 0.2 +"`
+assert_equal "1267650600228229401496703205376" `CLAC_MODE=decimal ./clac "2 100 ^"`
+assert_equal "0.66667" `CLAC_MODE=decimal CLAC_PRECISION=5 ./clac "2 3 /"`
+assert_equal "0.5" `CLAC_MODE=decimal ./clac "-1.5 2 %"`
+
+# Fixed point mode
+assert_equal "59.97" `CLAC_MODE=fixed ./clac "19.99 3 *"`
+assert_equal "0.33" `CLAC_MODE=fixed ./clac "1 3 /"`
+assert_equal "1.02" `CLAC_MODE=fixed ./clac "1.015"`
+assert_equal "0.333333333333333333" `CLAC_MODE=fixed CLAC_SCALE=18 ./clac "1 3 /"`
+
+# Rational mode
+assert_equal "1" `CLAC_MODE=rational ./clac "1 3 / 1 6 / + 2 *"`
+assert_equal "1" `CLAC_MODE=rational ./clac "0.1 0.2 + 0.3 ="`
+assert_equal "2.25" `CLAC_MODE=rational ./clac "2 3 / -2 ^"`
+assert_equal "1000000" `CLAC_MODE=rational ./clac "0 1000000 times 1 + end"`
+assert_equal "20200" `CLAC_MODE=rational ./clac "200 1 range map 1 2 / + 1000 times 3 + 3 - end end sum"`